@@ -0,0 +1,80 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/6/24
+ */
+
+#pragma once
+#ifndef UTIL_ARCH_CPU_FEATURE_H
+#define UTIL_ARCH_CPU_FEATURE_H
+
+#include <cstdint>
+#include <cpuid.h>
+
+inline namespace util_arch {
+
+	/*!
+	 * @brief Instruction set extensions of the running cpu, probed by CPUID.
+	 * @note The vector extensions also require the OS to save the extended
+	 * register states (XCR0), otherwise they are reported as unavailable.
+	 */
+	struct CPUFeature {
+		bool sse2       = false;
+		bool sse4_2     = false;
+		bool pclmul     = false;
+		bool avx        = false;
+		bool avx2       = false;
+		bool avx512f    = false;
+		bool clflushopt = false;
+		bool clwb       = false;
+
+	public:
+		static CPUFeature probe() {
+			CPUFeature feature;
+			uint32_t eax, ebx, ecx, edx;
+
+			if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+				return feature;
+			}
+			feature.sse2   = (edx & bit_SSE2) != 0;
+			feature.sse4_2 = (ecx & bit_SSE4_2) != 0;
+			feature.pclmul = (ecx & bit_PCLMUL) != 0;
+
+			// Check whether OS enables XMM/YMM (bit 1, 2) and opmask/ZMM (bit 5, 6, 7) states.
+			bool os_ymm = false, os_zmm = false;
+			if ((ecx & bit_OSXSAVE) != 0) {
+				uint64_t xcr0 = read_xcr0();
+				os_ymm = (xcr0 & 0x06) == 0x06;
+				os_zmm = (xcr0 & 0xE6) == 0xE6;
+			}
+			feature.avx = os_ymm && (ecx & bit_AVX) != 0;
+
+			if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+				return feature;
+			}
+			feature.avx2       = feature.avx && (ebx & bit_AVX2) != 0;
+			feature.avx512f    = os_zmm && (ebx & bit_AVX512F) != 0;
+			feature.clflushopt = (ebx & bit_CLFLUSHOPT) != 0;
+			feature.clwb       = (ebx & bit_CLWB) != 0;
+
+			return feature;
+		}
+
+	private:
+		static uint64_t read_xcr0() {
+			uint32_t xcr0_lo, xcr0_hi;
+			asm volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+			return (static_cast<uint64_t>(xcr0_hi) << 32) | xcr0_lo;
+		}
+	};
+
+	/*!
+	 * @brief Get features of the running cpu, which is probed only once.
+	 */
+	inline const CPUFeature &get_cpu_feature() {
+		static const CPUFeature feature = CPUFeature::probe();
+		return feature;
+	}
+
+}
+
+#endif //UTIL_ARCH_CPU_FEATURE_H
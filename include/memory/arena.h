@@ -0,0 +1,269 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/8
+ */
+
+#pragma once
+#ifndef UTIL_MEM_ARENA_H
+#define UTIL_MEM_ARENA_H
+
+#include <cassert>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <sys/mman.h>
+
+#include <util/utility_macro.h>
+#include <memory/memory_config.h>
+#include <memory/mapping.h>
+
+inline namespace util_mem {
+
+	/// The default size of chunks
+	#ifndef ARENA_CHUNK_SIZE_DEFINED
+		constexpr size_t ARENA_CHUNK_SIZE = 256_KB;
+	#else
+		constexpr size_t ARENA_CHUNK_SIZE = ARENA_CHUNK_SIZE_DEFINED;
+	#endif
+
+	/*!
+	 * @brief Bump allocator for scratch memory with the lifetime of a transaction.
+	 * Memory is carved from a chain of chunks and released in bulk by reset() or rollback(),
+	 * which keeps chunks for reuse. Only objects with non-trivial destructor are recorded,
+	 * so that releasing trivially destructible objects costs O(1).
+	 * An arena is not thread-safe, and each thread should use its own (see get_thread_arena()).
+	 */
+	class alignas(CACHE_LINE_SIZE) Arena {
+	private:
+		struct Chunk {
+			Chunk *next;
+			/// The size of chunk including this header
+			size_t size;
+		};
+
+		struct DestructorNode {
+			DestructorNode *prev;
+			void (*destroy)(void *);
+			void *obj;
+		};
+
+		static constexpr size_t CHUNK_HEADER_SIZE = util_macro::align_ceil(sizeof(Chunk), CACHE_LINE_SIZE);
+
+	public:
+		/*!
+		 * @brief A position of arena, which rollback() returns to
+		 */
+		struct Marker {
+			Chunk *chunk;
+			uint8_t *cur_ptr;
+			DestructorNode *destructor_head;
+		};
+
+	private:
+		Chunk *first_chunk_;
+		/// The chunk in use
+		Chunk *cur_chunk_;
+
+		uint8_t *cur_ptr_;
+
+		uint8_t *end_ptr_;
+		/// Objects to destroy, in reverse order of construction
+		DestructorNode *destructor_head_;
+
+		size_t chunk_size_;
+
+		bool huge_page_;
+
+	public:
+		/*!
+		 * @param chunk_size The size of chunks. It is rounded up to 2 MB with huge pages.
+		 * @param huge_page Whether to back chunks with huge pages, falling back to transparent huge pages
+		 */
+		explicit Arena(size_t chunk_size = ARENA_CHUNK_SIZE, bool huge_page = false):
+				first_chunk_(nullptr), cur_chunk_(nullptr), cur_ptr_(nullptr), end_ptr_(nullptr),
+				destructor_head_(nullptr),
+				chunk_size_(util_macro::align_ceil(chunk_size, huge_page ? HUGE_PAGE_2M_SIZE : MEM_PAGE_SIZE)),
+				huge_page_(huge_page) {}
+
+		Arena(const Arena &other) = delete;
+
+		~Arena() {
+			run_destructors(nullptr);
+			Chunk *chunk = first_chunk_;
+			while (chunk != nullptr) {
+				Chunk *next = chunk->next;
+				munmap(chunk, chunk->size);
+				chunk = next;
+			}
+		}
+
+	public:
+		/*!
+		 * @brief Allocate uninitialized memory
+		 * @param size The size of memory
+		 * @param align The alignment, power of 2 and no larger than the cache line
+		 */
+		void *allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+			assert(util_macro::is_2pow(align) && align <= CACHE_LINE_SIZE);
+			auto *ptr = reinterpret_cast<uint8_t *>(util_macro::ceil_2pow(reinterpret_cast<uintptr_t>(cur_ptr_), align));
+			if (ptr + size > end_ptr_ || cur_ptr_ == nullptr) [[unlikely]] {
+				next_chunk(size);
+				ptr = cur_ptr_;
+			}
+			cur_ptr_ = ptr + size;
+			return ptr;
+		}
+
+		/*!
+		 * @brief Allocate an array of uninitialized objects
+		 */
+		template<class T>
+		T *allocate_array(size_t num) {
+			static_assert(alignof(T) <= CACHE_LINE_SIZE);
+			return static_cast<T *>(allocate(sizeof(T) * num, alignof(T)));
+		}
+
+		/*!
+		 * @brief Construct an object in arena. The destructor is called at reset() or rollback(),
+		 * which is recorded only for types that are not trivially destructible.
+		 */
+		template<class T, class ...Args>
+		T *create(Args &&...args) {
+			static_assert(alignof(T) <= CACHE_LINE_SIZE);
+			if constexpr (std::is_trivially_destructible_v<T>) {
+				return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+			}
+			else {
+				auto *node = static_cast<DestructorNode *>(allocate(sizeof(DestructorNode), alignof(DestructorNode)));
+				T *obj = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+				node->prev    = destructor_head_;
+				node->destroy = [](void *ptr) { static_cast<T *>(ptr)->~T(); };
+				node->obj     = obj;
+				destructor_head_ = node;
+				return obj;
+			}
+		}
+
+		[[nodiscard]] Marker get_marker() const {
+			return { cur_chunk_, cur_ptr_, destructor_head_ };
+		}
+
+		/*!
+		 * @brief Release all memory allocated after the marker
+		 */
+		void rollback(const Marker &marker) {
+			run_destructors(marker.destructor_head);
+			if (marker.chunk == nullptr) {
+				rewind_to_first();
+				return;
+			}
+			cur_chunk_ = marker.chunk;
+			cur_ptr_   = marker.cur_ptr;
+			end_ptr_   = reinterpret_cast<uint8_t *>(cur_chunk_) + cur_chunk_->size;
+		}
+
+		/*!
+		 * @brief Release all memory, keeping chunks for later use
+		 */
+		void reset() {
+			run_destructors(nullptr);
+			rewind_to_first();
+		}
+
+		/*!
+		 * @brief Reset and return all chunks except the first one to system
+		 */
+		void release() {
+			reset();
+			if (first_chunk_ == nullptr) { return; }
+			Chunk *chunk = first_chunk_->next;
+			while (chunk != nullptr) {
+				Chunk *next = chunk->next;
+				munmap(chunk, chunk->size);
+				chunk = next;
+			}
+			first_chunk_->next = nullptr;
+		}
+
+		/*!
+		 * @brief Get the total size of chunks held by arena
+		 */
+		[[nodiscard]] size_t get_reserved_size() const {
+			size_t size = 0;
+			for (Chunk *chunk = first_chunk_; chunk != nullptr; chunk = chunk->next) {
+				size += chunk->size;
+			}
+			return size;
+		}
+
+	private:
+		void run_destructors(DestructorNode *until) {
+			while (destructor_head_ != until) {
+				destructor_head_->destroy(destructor_head_->obj);
+				destructor_head_ = destructor_head_->prev;
+			}
+		}
+
+		void rewind_to_first() {
+			cur_chunk_ = first_chunk_;
+			if (cur_chunk_ == nullptr) { return; }
+			cur_ptr_ = reinterpret_cast<uint8_t *>(cur_chunk_) + CHUNK_HEADER_SIZE;
+			end_ptr_ = reinterpret_cast<uint8_t *>(cur_chunk_) + cur_chunk_->size;
+		}
+
+		/*!
+		 * @brief Move to a chunk able to hold size bytes, reusing the next chunk if possible
+		 */
+		void next_chunk(size_t size) {
+			Chunk *next = cur_chunk_ == nullptr ? first_chunk_ : cur_chunk_->next;
+			if (next == nullptr || next->size - CHUNK_HEADER_SIZE < size) {
+				Chunk *chunk = map_chunk(std::max(chunk_size_, util_macro::align_ceil(size + CHUNK_HEADER_SIZE, chunk_size_)));
+				// Insert the new chunk before the next one, so that no chunk is skipped
+				chunk->next = next;
+				if (cur_chunk_ == nullptr) { first_chunk_ = chunk; }
+				else { cur_chunk_->next = chunk; }
+				next = chunk;
+			}
+			cur_chunk_ = next;
+			cur_ptr_   = reinterpret_cast<uint8_t *>(cur_chunk_) + CHUNK_HEADER_SIZE;
+			end_ptr_   = reinterpret_cast<uint8_t *>(cur_chunk_) + cur_chunk_->size;
+		}
+
+		Chunk *map_chunk(size_t size) {
+			void *ptr = MAP_FAILED;
+			if (huge_page_) {
+				ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			}
+			if (ptr == MAP_FAILED) {
+				ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (ptr == MAP_FAILED) {
+					perror("ERROR: Unable to map arena chunk");
+					exit(-1);
+				}
+				if (huge_page_) {
+					madvise(ptr, size, MADV_HUGEPAGE);
+				}
+			}
+			auto *chunk = static_cast<Chunk *>(ptr);
+			chunk->next = nullptr;
+			chunk->size = size;
+			return chunk;
+		}
+	};
+
+	/*!
+	 * @brief Get the arena of the current thread
+	 */
+	inline Arena &get_thread_arena() {
+		static thread_local Arena arena;
+		return arena;
+	}
+
+}
+
+#endif //UTIL_MEM_ARENA_H
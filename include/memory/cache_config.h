@@ -7,6 +7,7 @@
 #ifndef UTIL_MEM_CAHCE_CONFIG_H
 #define UTIL_MEM_CAHCE_CONFIG_H
 
+#include <cstddef>
 #include <cstdint>
 #include <immintrin.h>
 
@@ -20,6 +21,13 @@ inline namespace util_mem {
 		return (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
 	}
 
+	/*!
+	 * @brief Get the address of cache line which contains the pointed byte
+	 */
+	inline uintptr_t cache_line_floor(const void *ptr) {
+		return reinterpret_cast<uintptr_t>(ptr) & ~(static_cast<uintptr_t>(CACHE_LINE_SIZE) - 1);
+	}
+
 }
 
 #endif //UTIL_MEM_CAHCE_CONFIG_H
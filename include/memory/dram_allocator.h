@@ -0,0 +1,379 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/5
+ */
+
+#pragma once
+#ifndef UTIL_MEM_DRAM_ALLOCATOR_H
+#define UTIL_MEM_DRAM_ALLOCATOR_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <util/utility_macro.h>
+#include <util/atomic128.h>
+#include <thread/thread.h>
+#include <memory/memory_config.h>
+
+inline namespace util_mem {
+
+	/*
+	 * A size-class allocator for small DRAM objects (e.g. read/write sets of transactions).
+	 *
+	 * Objects are grouped by size classes which are multiples of cache line, so that no object
+	 * shares a cache line with others. Each registered thread (thread::get_tid()) owns a cache of
+	 * free blocks for each class, which serves most requests without any synchronization.
+	 * Caches exchange blocks with a lock-free central freelist per class by batches,
+	 * and new blocks are carved from spans. Memory of spans is reused but never returned to OS.
+	 * Unregistered threads bypass the cache and access the central freelist directly.
+	 */
+
+	namespace dram_allocator_detail {
+
+		/// Size classes: every cache line up to 512 B, then two classes per power of 2
+		inline constexpr std::array<uint32_t, 20> SIZE_CLASS_ARRAY = {
+			64, 128, 192, 256, 320, 384, 448, 512,
+			768, 1024, 1536, 2048, 3072, 4096, 6144, 8192,
+			12288, 16384, 24576, 32768
+		};
+
+		inline constexpr uint32_t NUM_SIZE_CLASS = SIZE_CLASS_ARRAY.size();
+
+		inline constexpr uint32_t MAX_SMALL_SIZE = SIZE_CLASS_ARRAY.back();
+
+		/// Map (size + 63) / 64 to the size class
+		inline constexpr auto SIZE_TO_CLASS_TABLE = []() {
+			std::array<uint8_t, MAX_SMALL_SIZE / CACHE_LINE_SIZE + 1> table{};
+			uint32_t size_class = 0;
+			for (uint32_t num_line = 0; num_line < table.size(); ++num_line) {
+				while (SIZE_CLASS_ARRAY[size_class] < num_line * CACHE_LINE_SIZE) {
+					++size_class;
+				}
+				table[num_line] = size_class;
+			}
+			return table;
+		}();
+
+		inline constexpr uint32_t get_size_class(size_t size) {
+			return SIZE_TO_CLASS_TABLE[(size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE];
+		}
+
+		/// The number of blocks moved between thread cache and central freelist at a time
+		inline constexpr uint32_t get_batch_size(uint32_t size_class) {
+			uint32_t num = 16_KB / SIZE_CLASS_ARRAY[size_class];
+			return num < 4 ? 4 : (num > 64 ? 64 : num);
+		}
+
+		/// Free block, which is at least one cache line
+		struct Block {
+			/// The next block in the same batch
+			Block *next;
+			/// The next batch in the central freelist, only valid for the head of batch
+			Block *next_batch;
+		};
+
+	}
+
+	class DRAMAllocator {
+	private:
+		using Block = dram_allocator_detail::Block;
+
+		static constexpr uint32_t NUM_SIZE_CLASS = dram_allocator_detail::NUM_SIZE_CLASS;
+
+		static constexpr size_t SPAN_SIZE = 256_KB;
+
+		/// Release a batch to the central freelist if cached blocks are more than this times of batch size
+		static constexpr uint32_t CACHE_LIMIT_FACTOR = 2;
+
+		/*!
+		 * @brief Treiber stack of batches. The top is a pointer with a counter increased by each update,
+		 * which are swapped together by cmpxchg16b, preventing ABA problem without assumption on the width of address.
+		 * Blocks are never unmapped, so that reading next_batch of a stale top is safe.
+		 */
+		struct alignas(CACHE_LINE_SIZE) CentralFreeList {
+			struct alignas(16) TaggedTop {
+				Block *ptr;
+				uint64_t counter;
+			};
+
+			TaggedTop top{nullptr, 0};
+
+			/*!
+			 * @brief Read the top by two loads, which may be torn but is then rejected by cas128()
+			 */
+			TaggedTop load_top() {
+				return {
+					std::atomic_ref<Block *>(top.ptr).load(std::memory_order::acquire),
+					std::atomic_ref<uint64_t>(top.counter).load(std::memory_order::relaxed)
+				};
+			}
+
+			void push_batch(Block *batch) {
+				TaggedTop old_top = load_top();
+				do {
+					batch->next_batch = old_top.ptr;
+				} while (!util::cas128(&top, old_top, TaggedTop{batch, old_top.counter + 1}));
+			}
+
+			Block *pop_batch() {
+				TaggedTop old_top = load_top();
+				Block *batch;
+				do {
+					batch = old_top.ptr;
+					if (batch == nullptr) {
+						return nullptr;
+					}
+				} while (!util::cas128(&top, old_top, TaggedTop{batch->next_batch, old_top.counter + 1}));
+				return batch;
+			}
+		};
+
+		struct FreeList {
+			Block *head   = nullptr;
+			uint32_t size = 0;
+		};
+
+		struct alignas(CACHE_LINE_SIZE) ThreadCache {
+			FreeList free_list_array[NUM_SIZE_CLASS];
+		};
+
+	private:
+		CentralFreeList central_array_[NUM_SIZE_CLASS];
+
+		ThreadCache cache_array_[thread::MAX_TID];
+
+		std::mutex span_mutex_;
+
+		std::vector<void *> span_array_;
+
+	public:
+		DRAMAllocator() = default;
+
+		DRAMAllocator(const DRAMAllocator &other) = delete;
+
+		~DRAMAllocator() {
+			for (void *span: span_array_) {
+				std::free(span);
+			}
+		}
+
+	public:
+		/*!
+		 * @brief Allocate memory aligned to cache line
+		 * @param size The size of memory
+		 * @return The allocated memory, or nullptr if out of memory
+		 */
+		void *allocate(size_t size) {
+			if (size > dram_allocator_detail::MAX_SMALL_SIZE) [[unlikely]] {
+				return ::operator new(size, std::align_val_t(CACHE_LINE_SIZE), std::nothrow);
+			}
+
+			uint32_t size_class = dram_allocator_detail::get_size_class(size);
+			uint32_t tid        = thread::get_tid();
+			if (tid >= static_cast<uint32_t>(thread::MAX_TID)) [[unlikely]] {
+				return allocate_from_central(size_class);
+			}
+
+			FreeList &free_list = cache_array_[tid].free_list_array[size_class];
+			if (free_list.head == nullptr) [[unlikely]] {
+				if (!refill(free_list, size_class)) {
+					return nullptr;
+				}
+			}
+			Block *block   = free_list.head;
+			free_list.head = block->next;
+			--free_list.size;
+			return block;
+		}
+
+		/*!
+		 * @brief Free memory allocated by allocate() with the same size
+		 * @param ptr The allocated memory
+		 * @param size The size passed to allocate()
+		 */
+		void deallocate(void *ptr, size_t size) {
+			if (ptr == nullptr) [[unlikely]] {
+				return;
+			}
+			if (size > dram_allocator_detail::MAX_SMALL_SIZE) [[unlikely]] {
+				::operator delete(ptr, std::align_val_t(CACHE_LINE_SIZE));
+				return;
+			}
+
+			uint32_t size_class = dram_allocator_detail::get_size_class(size);
+			uint32_t tid        = thread::get_tid();
+			auto *block         = static_cast<Block *>(ptr);
+			if (tid >= static_cast<uint32_t>(thread::MAX_TID)) [[unlikely]] {
+				block->next = nullptr;
+				central_array_[size_class].push_batch(block);
+				return;
+			}
+
+			FreeList &free_list = cache_array_[tid].free_list_array[size_class];
+			block->next    = free_list.head;
+			free_list.head = block;
+			++free_list.size;
+
+			uint32_t batch_size = dram_allocator_detail::get_batch_size(size_class);
+			if (free_list.size > CACHE_LIMIT_FACTOR * batch_size) [[unlikely]] {
+				release(free_list, size_class, batch_size);
+			}
+		}
+
+		/*!
+		 * @brief Return all blocks cached by the current thread to the central freelist,
+		 * e.g. before the thread exits.
+		 */
+		void flush_thread_cache() {
+			uint32_t tid = thread::get_tid();
+			if (tid >= static_cast<uint32_t>(thread::MAX_TID)) {
+				return;
+			}
+			for (uint32_t size_class = 0; size_class < NUM_SIZE_CLASS; ++size_class) {
+				FreeList &free_list = cache_array_[tid].free_list_array[size_class];
+				if (free_list.size > 0) {
+					release(free_list, size_class, free_list.size);
+				}
+			}
+		}
+
+	private:
+		void *allocate_from_central(uint32_t size_class) {
+			Block *batch = central_array_[size_class].pop_batch();
+			if (batch == nullptr) {
+				batch = allocate_span(size_class);
+				if (batch == nullptr) {
+					return nullptr;
+				}
+			}
+			// Return the rest of batch
+			if (batch->next != nullptr) {
+				central_array_[size_class].push_batch(batch->next);
+			}
+			return batch;
+		}
+
+		bool refill(FreeList &free_list, uint32_t size_class) {
+			Block *batch = central_array_[size_class].pop_batch();
+			if (batch == nullptr) {
+				batch = allocate_span(size_class);
+				if (batch == nullptr) {
+					return false;
+				}
+			}
+
+			uint32_t num = 1;
+			Block *tail  = batch;
+			for (; tail->next != nullptr; tail = tail->next) {
+				++num;
+			}
+			tail->next     = free_list.head;
+			free_list.head = batch;
+			free_list.size += num;
+			return true;
+		}
+
+		void release(FreeList &free_list, uint32_t size_class, uint32_t num) {
+			Block *batch = free_list.head;
+			Block *tail  = batch;
+			for (uint32_t i = 1; i < num; ++i) {
+				tail = tail->next;
+			}
+			free_list.head = tail->next;
+			free_list.size -= num;
+			tail->next     = nullptr;
+			central_array_[size_class].push_batch(batch);
+		}
+
+		/*!
+		 * @brief Carve a new span into batches. One batch is returned and the others are pushed to central freelist.
+		 */
+		Block *allocate_span(uint32_t size_class) {
+			size_t block_size   = dram_allocator_detail::SIZE_CLASS_ARRAY[size_class];
+			uint32_t batch_size = dram_allocator_detail::get_batch_size(size_class);
+			size_t span_size    = std::max<size_t>(SPAN_SIZE, block_size * batch_size);
+			span_size           = span_size / block_size * block_size;
+
+			auto *span = static_cast<uint8_t *>(std::aligned_alloc(MEM_PAGE_SIZE, util_macro::ceil_2pow(span_size, MEM_PAGE_SIZE)));
+			if (span == nullptr) {
+				return nullptr;
+			}
+			{
+				std::lock_guard<std::mutex> lock(span_mutex_);
+				span_array_.emplace_back(span);
+			}
+
+			size_t num_block = span_size / block_size;
+			Block *res       = nullptr;
+			for (size_t batch_begin = 0; batch_begin < num_block; batch_begin += batch_size) {
+				size_t batch_end = std::min<size_t>(batch_begin + batch_size, num_block);
+				for (size_t i = batch_begin; i < batch_end; ++i) {
+					auto *block = reinterpret_cast<Block *>(span + i * block_size);
+					block->next = (i + 1 < batch_end) ? reinterpret_cast<Block *>(span + (i + 1) * block_size) : nullptr;
+				}
+
+				auto *batch = reinterpret_cast<Block *>(span + batch_begin * block_size);
+				if (res == nullptr) {
+					res = batch;
+				}
+				else {
+					central_array_[size_class].push_batch(batch);
+				}
+			}
+			return res;
+		}
+	};
+
+	/*!
+	 * @brief Get the global DRAM allocator
+	 */
+	inline DRAMAllocator &get_dram_allocator() {
+		static DRAMAllocator allocator;
+		return allocator;
+	}
+
+	inline void *dram_allocate(size_t size) {
+		return get_dram_allocator().allocate(size);
+	}
+
+	inline void dram_deallocate(void *ptr, size_t size) {
+		get_dram_allocator().deallocate(ptr, size);
+	}
+
+	/*!
+	 * @brief Allocator for STL containers, backed by the global DRAM allocator
+	 */
+	template<class T>
+	struct DRAMStdAllocator {
+		using value_type = T;
+
+		DRAMStdAllocator() = default;
+
+		template<class U>
+		DRAMStdAllocator(const DRAMStdAllocator<U> &) {}
+
+		T *allocate(size_t n) {
+			auto *res = static_cast<T *>(dram_allocate(n * sizeof(T)));
+			if (res == nullptr) {
+				throw std::bad_alloc();
+			}
+			return res;
+		}
+
+		void deallocate(T *ptr, size_t n) {
+			dram_deallocate(ptr, n * sizeof(T));
+		}
+
+		template<class U>
+		bool operator==(const DRAMStdAllocator<U> &) const { return true; }
+	};
+
+}
+
+#endif //UTIL_MEM_DRAM_ALLOCATOR_H
@@ -1,5 +1,5 @@
 /*
- * @author: BL-GS 
+ * @author: BL-GS
  * @date:   2023/6/3
  */
 
@@ -8,20 +8,79 @@
 #define UTIL_MEM_ALLOCATOR_FILE_DESCRIPTOR_H
 
 #include <cassert>
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <limits>
+#include <string>
+#include <string_view>
 #include <filesystem>
 
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
 
+#include <logger/logger.h>
+#include <util/crc32c.h>
 #include <memory/memory_config.h>
+#include <memory/nvm_config.h>
+#include <memory/mapping.h>
 
 inline namespace util_mem {
 
+	/*!
+	 * @brief The way to get the file of pool
+	 * CREATE: Create a new pool, discarding the existing file.
+	 * OPEN: Open an existing pool, whose header should be valid.
+	 * CREATE_OR_OPEN: Open the pool if the file exists, otherwise create a new one.
+	 */
+	enum class FileMode {
+		CREATE,
+		OPEN,
+		CREATE_OR_OPEN
+	};
+
+	/*!
+	 * @brief Header at the beginning of pool file.
+	 * Immutable fields are protected by checksum, while the clean flag lives in a separate
+	 * cache line, so that it can be updated by one 8-byte store and one flush
+	 * (followed by msync of the header page if the file is not mapped with MAP_SYNC).
+	 */
+	struct PoolHeader {
+		static constexpr uint64_t MAGIC   = 0x4C4F4F504C495455ULL; // "UTILPOOL"
+		static constexpr uint32_t VERSION = 2;
+
+		uint64_t magic;
+		uint32_t version;
+		uint32_t header_size;
+		/// The size of whole file, including header
+		uint64_t pool_size;
+		/// Identify the layout of data, defined by user
+		uint64_t layout_id;
+		/// CRC32C of fields above
+		uint64_t checksum;
+		/// Non-zero if the pool has been closed normally
+		alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> clean;
+
+		/*!
+		 * @brief CRC32C of immutable fields
+		 */
+		[[nodiscard]] uint64_t compute_checksum() const {
+			return util::crc32c(this, offsetof(PoolHeader, checksum));
+		}
+	};
+
 	struct FileDescriptor {
 	public:
 		/// The align size of start pointer
 		static constexpr size_t ALIGN_SIZE = CACHE_LINE_SIZE;
+		/// The size reserved for header, which keeps data aligned to page
+		static constexpr size_t HEADER_SIZE = MEM_PAGE_SIZE;
+
+		static_assert(sizeof(PoolHeader) <= HEADER_SIZE);
 
 	public:
 		/// File descriptor
@@ -30,48 +89,198 @@ inline namespace util_mem {
 		std::filesystem::path file_path;
 		/// The start pointer of mapped file
 		uint8_t *start_ptr;
-		/// The aligned start pointer of mapped file
+		/// The aligned start pointer of data, which is behind the header
 		uint8_t *aligned_start_ptr;
 		/// The total size of mapped area
 		uint64_t total_size;
-		/// The total size of aligned mapped area
+		/// The total size of aligned data area
 		uint64_t aligned_total_size;
+		/// Whether the pool was not closed normally last time, so that data should be recovered
+		bool dirty_on_open;
+		/// Whether to remove the file when it is closed, which is useful for temporary files
+		bool remove_on_close;
+		/// Whether the file is mapped with MAP_SYNC, so that flushes of cpu are enough for durability
+		bool map_sync;
 
 	public:
-		FileDescriptor(std::string_view dir_name, std::string_view path, size_t alloc_size):
-				fd(0), file_path(std::string(dir_name) + '/' + path.data()), start_ptr(nullptr), aligned_start_ptr(nullptr), total_size(alloc_size)  {
-			// Create directories of the path
-			if (!std::filesystem::exists(dir_name)) {
-				std::filesystem::create_directories(dir_name);
-			}
+		/*!
+		 * @brief Map a pool file.
+		 * @param dir_name The directory of file, created if necessary
+		 * @param path The name of file
+		 * @param alloc_size The size of whole file. It is ignored if an existing pool is opened.
+		 * @param mode The way to get the file
+		 * @param layout_id Identify the layout of data, which should match the existing pool
+		 * @param option Options of mapping, e.g. MAP_SYNC and alignment for huge pages
+		 */
+		FileDescriptor(std::string_view dir_name, std::string_view path, size_t alloc_size,
+		               FileMode mode = FileMode::CREATE, uint64_t layout_id = 0, const MapOption &option = MapOption()):
+				fd(-1), file_path(std::string(dir_name) + '/' + path.data()), start_ptr(nullptr), aligned_start_ptr(nullptr),
+				total_size(alloc_size), aligned_total_size(0), dirty_on_open(false), remove_on_close(false), map_sync(false) {
 
-			// Open file and truncate the size of file
-			fd = open(file_path.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-			int td = ftruncate(fd, alloc_size);
-			if (fd < 0 || td < 0) {
-				perror("Unable to create file");
-				exit(-1);
+			bool create = mode == FileMode::CREATE ||
+			              (mode == FileMode::CREATE_OR_OPEN && !std::filesystem::exists(file_path));
+
+			if (create) {
+				create_file();
+			}
+			else {
+				open_file();
 			}
 
-			// mmap() memory range
-			// MAP_POPULATE avoid running-time page fault
-			start_ptr = (uint8_t *)mmap(NULL, alloc_size, (PROT_READ | PROT_WRITE), MAP_SHARED | MAP_POPULATE, fd, 0);
+			// mmap() memory range with requested alignment
+			// MAP_POPULATE (by default) avoid running-time page fault
+			start_ptr = (uint8_t *)map_file(fd, total_size, option, map_sync);
 			if (start_ptr == MAP_FAILED) {
 				perror("ERROR: mmap() is not working !!! ");
 				exit(-1);
 			}
 
-			aligned_start_ptr  = (uint8_t *)align_ptr(start_ptr);
+			aligned_start_ptr  = (uint8_t *)align_ptr(start_ptr + HEADER_SIZE);
 			aligned_total_size = total_size - ((uint8_t *)aligned_start_ptr - (uint8_t *)start_ptr);
+
+			if (create) {
+				init_header(layout_id);
+			}
+			else {
+				check_header(layout_id);
+			}
+
+			// The pool is dirty until it is closed normally
+			dirty_on_open = get_header()->clean.load(std::memory_order::relaxed) == 0;
+			set_clean(false);
 		}
 
+		FileDescriptor(const FileDescriptor &other) = delete;
+
 		~FileDescriptor() {
+			// Without MAP_SYNC, data may only be in page cache, which should reach the file before the clean flag
+			if (map_sync || msync(start_ptr, total_size, MS_SYNC) == 0) {
+				set_clean(true);
+			}
+			else {
+				perror("Unable to sync the pool, which is left dirty");
+			}
 			munmap(start_ptr, total_size);
 			close(fd);
-			std::filesystem::remove(file_path);
+			if (remove_on_close) {
+				std::filesystem::remove(file_path);
+			}
+		}
+
+	public:
+		/*!
+		 * @brief Whether the pool was not closed normally, so that data should be scanned and recovered.
+		 * A clean pool can skip recovery and restart immediately.
+		 */
+		[[nodiscard]] bool needs_recovery() const {
+			return dirty_on_open;
+		}
+
+		[[nodiscard]] PoolHeader *get_header() const {
+			return reinterpret_cast<PoolHeader *>(start_ptr);
+		}
+
+		[[nodiscard]] uint64_t get_layout_id() const {
+			return get_header()->layout_id;
+		}
+
+		/*!
+		 * @brief Report whether the mapping is backed by huge pages
+		 */
+		[[nodiscard]] MappingPageInfo get_page_info() const {
+			return get_mapping_page_info(start_ptr);
 		}
 
 	private:
+		void create_file() {
+			// Create directories of the path
+			if (!file_path.parent_path().empty() && !std::filesystem::exists(file_path.parent_path())) {
+				std::filesystem::create_directories(file_path.parent_path());
+			}
+
+			if (total_size <= HEADER_SIZE) {
+				util::logger_exception("Pool size ", total_size, " is too small to hold the header: ", file_path.string());
+			}
+
+			// Open file and truncate the size of file
+			fd = open(file_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+			if (fd < 0 || ftruncate(fd, total_size) < 0) {
+				perror("Unable to create file");
+				exit(-1);
+			}
+		}
+
+		void open_file() {
+			fd = open(file_path.c_str(), O_RDWR);
+			if (fd < 0) {
+				perror("Unable to open file");
+				exit(-1);
+			}
+
+			struct stat file_stat{};
+			if (fstat(fd, &file_stat) < 0) {
+				perror("Unable to get the size of file");
+				exit(-1);
+			}
+			total_size = file_stat.st_size;
+			if (total_size <= HEADER_SIZE) {
+				util::logger_exception("File is too small to be a pool: ", file_path.string());
+			}
+		}
+
+		void init_header(uint64_t layout_id) {
+			PoolHeader *header  = get_header();
+			header->magic       = PoolHeader::MAGIC;
+			header->version     = PoolHeader::VERSION;
+			header->header_size = HEADER_SIZE;
+			header->pool_size   = total_size;
+			header->layout_id   = layout_id;
+			header->checksum    = header->compute_checksum();
+			header->clean.store(1, std::memory_order::relaxed);
+			sync_header();
+		}
+
+		void check_header(uint64_t layout_id) const {
+			PoolHeader *header = get_header();
+			if (header->magic != PoolHeader::MAGIC) {
+				util::logger_exception("Invalid magic of pool: ", file_path.string());
+			}
+			if (header->version != PoolHeader::VERSION || header->header_size != HEADER_SIZE) {
+				util::logger_exception("Unsupported version ", header->version, " of pool: ", file_path.string());
+			}
+			if (header->checksum != header->compute_checksum()) {
+				util::logger_exception("Corrupted header of pool: ", file_path.string());
+			}
+			if (header->pool_size != total_size) {
+				util::logger_exception("Size of pool ", header->pool_size, " mismatches with file size ", total_size, ": ", file_path.string());
+			}
+			if (header->layout_id != layout_id) {
+				util::logger_exception("Layout ", header->layout_id, " of pool mismatches with ", layout_id, ": ", file_path.string());
+			}
+		}
+
+		void set_clean(bool clean) {
+			PoolHeader *header = get_header();
+			header->clean.store(clean ? 1 : 0, std::memory_order::release);
+			NVMRuntime::pwb(&header->clean);
+			NVMRuntime::fence();
+			if (!map_sync) {
+				msync(start_ptr, HEADER_SIZE, MS_SYNC);
+			}
+		}
+
+		/*!
+		 * @brief Make the header persistent, on both DAX and page-cached file systems.
+		 */
+		void sync_header() {
+			PoolHeader *header = get_header();
+			NVMRuntime::pwb_range(header, sizeof(PoolHeader));
+			NVMRuntime::fence();
+			if (!map_sync) {
+				msync(start_ptr, HEADER_SIZE, MS_SYNC);
+			}
+		}
+
 		static void *align_ptr(void *ptr) {
 			return reinterpret_cast<void *>(
 					(reinterpret_cast<size_t>(ptr) + (ALIGN_SIZE - 1)) & (~(ALIGN_SIZE - 1))
@@ -82,7 +291,7 @@ inline namespace util_mem {
 	/*!
 	 * @brief Allocate a unique id for file
 	 */
-	std::string allocate_file_index() {
+	inline std::string allocate_file_index() {
 		static std::atomic<uint32_t> index_counter{0};
 		uint32_t res = index_counter++;
 		assert(res < std::numeric_limits<uint32_t>::max());
@@ -92,7 +301,7 @@ inline namespace util_mem {
 	/*!
 	 * @brief Allocate a unique filename
 	 */
-	std::string allocate_file_name() {
+	inline std::string allocate_file_name() {
 		return std::string("Data_") + allocate_file_index();
 	}
 
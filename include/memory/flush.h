@@ -10,7 +10,9 @@
 #include <cstdint>
 #include <immintrin.h>
 
+#include <arch/cpu_feature.h>
 #include <memory/cache_config.h>
+#include <memory/persist_stats.h>
 
 inline namespace util_mem {
 
@@ -19,51 +21,73 @@ inline namespace util_mem {
 	#endif
 	#define PWB_ENUM Flush::PWB_DEFINED
 
+	/*!
+	 * @brief Type of flush instruction
+	 * NONE: No flush at all, for platforms whose cpu caches are in the persistence domain (eADR).
+	 * SIMULATED: Flushes and fences are recorded by the persistence simulator (see nvm_simulator.h), for debug.
+	 * RUNTIME: The best one supported by the running platform, detected at runtime (see flush_detect.h).
+	 */
 	enum class Flush {
 		CLWB,
 		CLFLUSH,
-		CLFLUSHOPT
+		CLFLUSHOPT,
+		NONE,
+		SIMULATED,
+		RUNTIME
 	};
 
 	inline constexpr Flush get_current_pwb_type() {
 		return PWB_ENUM;
 	}
 
+	/*
+	 * clwb and clflushopt are encoded by bytes (as PMDK does),
+	 * so that no -mclwb/-mclflushopt is required and the binary runs on any x86-64 cpu
+	 * as long as they are not executed.
+	 */
+
 	__attribute__((always_inline)) inline void clwb(void *target) {
-		_mm_clwb(target);
+		asm volatile(".byte 0x66; xsaveopt %0" : "+m"(*static_cast<volatile char *>(target)));
+		persist_stat_add_pwb();
 	}
 
 	__attribute__((always_inline)) inline void clflush(void *target) {
 		_mm_clflush(target);
+		persist_stat_add_pwb();
 	}
 
 	__attribute__((always_inline)) inline void clflushopt(void *target) {
-		_mm_clflushopt(target);
+		asm volatile(".byte 0x66; clflush %0" : "+m"(*static_cast<volatile char *>(target)));
+		persist_stat_add_pwb();
 	}
 
 	__attribute__((always_inline)) inline void clwb_range(void *start_ptr, uint32_t size) {
-		uint8_t *target = static_cast<uint8_t *>(start_ptr);
-		for (uint32_t i = 0; i < size; i += CACHE_LINE_SIZE) {
-			_mm_clwb(target + i);
+		uintptr_t target = cache_line_floor(start_ptr);
+		uintptr_t end    = reinterpret_cast<uintptr_t>(start_ptr) + size;
+		for (; target < end; target += CACHE_LINE_SIZE) {
+			clwb(reinterpret_cast<void *>(target));
 		}
 	}
 
 	__attribute__((always_inline)) inline void clflush_range(void *start_ptr, uint32_t size) {
-		uint8_t *target = static_cast<uint8_t *>(start_ptr);
-		for (uint32_t i = 0; i < size; i += CACHE_LINE_SIZE) {
-			_mm_clflush(target + i);
+		uintptr_t target = cache_line_floor(start_ptr);
+		uintptr_t end    = reinterpret_cast<uintptr_t>(start_ptr) + size;
+		for (; target < end; target += CACHE_LINE_SIZE) {
+			clflush(reinterpret_cast<void *>(target));
 		}
 	}
 
 	__attribute__((always_inline)) inline void clflushopt_range(void *start_ptr, uint32_t size) {
-		uint8_t *target = static_cast<uint8_t *>(start_ptr);
-		for (uint32_t i = 0; i < size; i += CACHE_LINE_SIZE) {
-			_mm_clflushopt(target + i);
+		uintptr_t target = cache_line_floor(start_ptr);
+		uintptr_t end    = reinterpret_cast<uintptr_t>(start_ptr) + size;
+		for (; target < end; target += CACHE_LINE_SIZE) {
+			clflushopt(reinterpret_cast<void *>(target));
 		}
 	}
 
 	__attribute__((always_inline)) inline void sfence() {
 		asm volatile("sfence" ::: "memory");
+		persist_stat_add_fence();
 	}
 
 	__attribute__((always_inline)) inline void lfence() {
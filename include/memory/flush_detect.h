@@ -0,0 +1,88 @@
+/*
+ * @author: BL-GS 
+ * @date:   2023/6/17
+ */
+
+#pragma once
+#ifndef UTIL_MEM_FLUSH_DETECT_H
+#define UTIL_MEM_FLUSH_DETECT_H
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <filesystem>
+
+#include <arch/cpu_feature.h>
+#include <memory/flush.h>
+
+/*
+ * One-time detection of the flush instruction for Flush::RUNTIME,
+ * which is kept apart from flush.h as it reads the environment and sysfs.
+ */
+
+inline namespace util_mem {
+
+	/// Environment variable forcing (1) or forbidding (0) the flush-free mode, same as PMDK
+	constexpr const char *PMEM_NO_FLUSH_ENV = "PMEM_NO_FLUSH";
+
+	/// Directory of NVDIMM regions, each of which reports its persistence domain
+	constexpr const char *PMEM_REGION_DIR = "/sys/bus/nd/devices";
+
+	/*!
+	 * @brief Detect whether cpu caches are in the persistence domain (eADR), so that flush is unnecessary.
+	 * The environment variable PMEM_NO_FLUSH takes precedence. Otherwise, all NVDIMM regions
+	 * should report "cpu_cache" as their persistence domain.
+	 */
+	inline bool detect_persistent_cache() {
+		if (const char *env = std::getenv(PMEM_NO_FLUSH_ENV); env != nullptr && env[0] != '\0') {
+			return std::strcmp(env, "0") != 0;
+		}
+
+		std::error_code error_code;
+		std::filesystem::directory_iterator dir_iter(PMEM_REGION_DIR, error_code);
+		if (error_code) { return false; }
+
+		bool found_region = false;
+		for (const auto &entry: dir_iter) {
+			if (entry.path().filename().string().rfind("region", 0) != 0) { continue; }
+
+			std::ifstream domain_file(entry.path() / "persistence_domain");
+			if (!domain_file.is_open()) { continue; }
+
+			std::string domain;
+			domain_file >> domain;
+			if (domain != "cpu_cache") { return false; }
+			found_region = true;
+		}
+		return found_region;
+	}
+
+	/*!
+	 * @brief Detect the best flush instruction supported by the running platform.
+	 */
+	inline Flush detect_pwb_type() {
+		if (detect_persistent_cache()) {
+			return Flush::NONE;
+		}
+		const CPUFeature &feature = get_cpu_feature();
+		if (feature.clwb) {
+			return Flush::CLWB;
+		}
+		if (feature.clflushopt) {
+			return Flush::CLFLUSHOPT;
+		}
+		return Flush::CLFLUSH;
+	}
+
+	/*!
+	 * @brief Get the flush instruction chosen for the running cpu, which is detected only once.
+	 */
+	inline Flush get_runtime_pwb_type() {
+		static const Flush pwb_type = detect_pwb_type();
+		return pwb_type;
+	}
+
+}
+
+#endif //UTIL_MEM_FLUSH_DETECT_H
@@ -0,0 +1,162 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/6/28
+ */
+
+#pragma once
+#ifndef UTIL_MEM_FLUSH_SET_H
+#define UTIL_MEM_FLUSH_SET_H
+
+#include <cstdint>
+#include <cstring>
+
+#include <util/utility_macro.h>
+#include <memory/cache_config.h>
+#include <memory/nvm_config.h>
+
+inline namespace util_mem {
+
+	/*!
+	 * @brief Set of cache lines to be flushed in the current persist epoch.
+	 * Lines are deduplicated by a small open-addressing table, so that a line written several times
+	 * (e.g. adjacent fields) is flushed only once by drain().
+	 * If the set is full, recorded lines are flushed (without fence) in advance to make room.
+	 * @tparam NVMType The configuration of flush and fence
+	 * @tparam Capacity The max number of lines recorded before an early flush
+	 */
+	template<class NVMType = NVM, uint32_t Capacity = 256>
+	class FlushSet {
+	private:
+		static_assert(util_macro::is_2pow(Capacity), "Capacity of FlushSet should be power of 2");
+
+		/// Keep the load factor of table no more than 0.5
+		static constexpr uint32_t TABLE_SIZE = Capacity * 2;
+
+		static constexpr uint32_t TABLE_MASK = TABLE_SIZE - 1;
+
+		struct Slot {
+			/// The address of cache line
+			uintptr_t line;
+			/// The slot is occupied only if its epoch equals to the epoch of set
+			uint64_t epoch;
+		};
+
+	private:
+		Slot table_[TABLE_SIZE];
+		/// Lines in order of insertion, for fast traversal
+		uintptr_t line_array_[Capacity];
+
+		uint32_t size_;
+
+		uint64_t epoch_;
+
+	public:
+		FlushSet(): size_(0), epoch_(1) {
+			std::memset(table_, 0, sizeof(table_));
+		}
+
+		FlushSet(const FlushSet &other) = delete;
+
+		~FlushSet() = default;
+
+	public:
+		/*!
+		 * @brief Record the cache line containing target
+		 */
+		void add(const void *target) {
+			add_line(cache_line_floor(target));
+		}
+
+		/*!
+		 * @brief Record all cache lines overlapped by [start_ptr, start_ptr + size)
+		 */
+		void add_range(const void *start_ptr, size_t size) {
+			uintptr_t line = cache_line_floor(start_ptr);
+			uintptr_t end  = reinterpret_cast<uintptr_t>(start_ptr) + size;
+			for (; line < end; line += CACHE_LINE_SIZE) {
+				add_line(line);
+			}
+		}
+
+		/*!
+		 * @brief Flush all recorded lines without fence, and start a new epoch.
+		 */
+		void flush() {
+			for (uint32_t i = 0; i < size_; ++i) {
+				NVMType::pwb(reinterpret_cast<void *>(line_array_[i]));
+			}
+			reset_epoch();
+		}
+
+		/*!
+		 * @brief Flush all recorded lines, issue one fence and start a new epoch.
+		 */
+		void drain() {
+			flush();
+			NVMType::fence();
+		}
+
+		/*!
+		 * @brief Discard all recorded lines without flushing them, in O(1).
+		 */
+		void reset_epoch() {
+			size_ = 0;
+			++epoch_;
+		}
+
+		[[nodiscard]] uint32_t size() const {
+			return size_;
+		}
+
+		[[nodiscard]] bool empty() const {
+			return size_ == 0;
+		}
+
+		[[nodiscard]] bool contains(const void *target) const {
+			uintptr_t line = cache_line_floor(target);
+			for (uint32_t idx = hash_line(line); table_[idx].epoch == epoch_; idx = (idx + 1) & TABLE_MASK) {
+				if (table_[idx].line == line) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+	private:
+		void add_line(uintptr_t line) {
+			uint32_t idx = hash_line(line);
+			for (; table_[idx].epoch == epoch_; idx = (idx + 1) & TABLE_MASK) {
+				if (table_[idx].line == line) {
+					return;
+				}
+			}
+
+			if (size_ == Capacity) [[unlikely]] {
+				flush();
+				idx = hash_line(line);
+			}
+
+			table_[idx].line  = line;
+			table_[idx].epoch = epoch_;
+			line_array_[size_++] = line;
+		}
+
+		static uint32_t hash_line(uintptr_t line) {
+			// Fibonacci hashing on the index of cache line
+			uint64_t line_id = line / CACHE_LINE_SIZE;
+			return static_cast<uint32_t>((line_id * 0x9E3779B97F4A7C15ULL) >> 32) & TABLE_MASK;
+		}
+	};
+
+	/*!
+	 * @brief Get the flush set of the current thread
+	 */
+	template<class NVMType = NVM>
+	inline FlushSet<NVMType> &get_thread_flush_set() {
+		static thread_local FlushSet<NVMType> flush_set;
+		return flush_set;
+	}
+
+}
+
+#endif //UTIL_MEM_FLUSH_SET_H
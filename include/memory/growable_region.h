@@ -0,0 +1,218 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/3
+ */
+
+#pragma once
+#ifndef UTIL_MEM_GROWABLE_REGION_H
+#define UTIL_MEM_GROWABLE_REGION_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <filesystem>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <logger/logger.h>
+#include <memory/memory_config.h>
+#include <memory/mapping.h>
+#include <memory/file_descriptor.h>
+
+inline namespace util_mem {
+
+	/// The default granularity of growth
+	#ifndef GROWABLE_REGION_CHUNK_SIZE_DEFINED
+		constexpr size_t GROWABLE_REGION_CHUNK_SIZE = 64_MB;
+	#else
+		constexpr size_t GROWABLE_REGION_CHUNK_SIZE = GROWABLE_REGION_CHUNK_SIZE_DEFINED;
+	#endif
+
+	/*!
+	 * @brief A file mapping which grows in place.
+	 * A large virtual range is reserved by PROT_NONE at construction, and the file is extended
+	 * and mapped into the range chunk by chunk with MAP_FIXED, so that existing pointers keep valid.
+	 * Growth is serialized by a mutex, while readers only need the acquire load of mapped size:
+	 * any address below get_mapped_size() is accessible.
+	 */
+	class GrowableRegion {
+	private:
+		int fd_;
+
+		std::filesystem::path file_path_;
+
+		uint8_t *start_ptr_;
+		/// The size of reserved virtual range
+		size_t reserve_size_;
+		/// The granularity of growth, multiple of page (and of alignment for huge pages)
+		size_t chunk_size_;
+
+		MapOption option_;
+
+		/// Whether all chunks are mapped with MAP_SYNC, which is written under grow_mutex_ but read without lock
+		std::atomic<bool> map_sync_;
+
+		std::mutex grow_mutex_;
+
+		std::atomic<size_t> mapped_size_;
+
+	public:
+		/// Whether to remove the file when it is closed, which is useful for temporary files
+		bool remove_on_close;
+
+	public:
+		/*!
+		 * @brief Reserve the virtual range and map the initial part of file.
+		 * @param dir_name The directory of file, created if necessary
+		 * @param path The name of file
+		 * @param initial_size The initial size of mapping. An opened file keeps its size if it is larger.
+		 * @param reserve_size The max size that the region is able to grow to
+		 * @param mode The way to get the file
+		 * @param chunk_size The granularity of growth
+		 * @param option Options of mapping
+		 */
+		GrowableRegion(std::string_view dir_name, std::string_view path, size_t initial_size, size_t reserve_size,
+		               FileMode mode = FileMode::CREATE, size_t chunk_size = GROWABLE_REGION_CHUNK_SIZE,
+		               const MapOption &option = MapOption()):
+				fd_(-1), file_path_(std::string(dir_name) + '/' + path.data()), start_ptr_(nullptr),
+				reserve_size_(round_up(reserve_size, chunk_size)), chunk_size_(chunk_size),
+				option_(option), map_sync_(true), mapped_size_(0), remove_on_close(false) {
+
+			if (chunk_size_ % MEM_PAGE_SIZE != 0 || (option_.alignment != 0 && chunk_size_ % option_.alignment != 0)) {
+				util::logger_exception("Chunk size ", chunk_size_, " should be multiple of page and alignment");
+			}
+
+			bool create = mode == FileMode::CREATE ||
+			              (mode == FileMode::CREATE_OR_OPEN && !std::filesystem::exists(file_path_));
+			if (create && !file_path_.parent_path().empty() && !std::filesystem::exists(file_path_.parent_path())) {
+				std::filesystem::create_directories(file_path_.parent_path());
+			}
+
+			fd_ = create ? open(file_path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)
+			             : open(file_path_.c_str(), O_RDWR);
+			if (fd_ < 0) {
+				perror("Unable to open file");
+				exit(-1);
+			}
+
+			start_ptr_ = static_cast<uint8_t *>(reserve_aligned_range(reserve_size_, option_.alignment));
+			if (start_ptr_ == MAP_FAILED) {
+				perror("ERROR: Unable to reserve address space");
+				exit(-1);
+			}
+
+			struct stat file_stat{};
+			fstat(fd_, &file_stat);
+			if (!grow(std::max<size_t>(initial_size, file_stat.st_size))) {
+				util::logger_exception("Unable to map initial ", initial_size, " bytes of ", file_path_.string());
+			}
+		}
+
+		GrowableRegion(const GrowableRegion &other) = delete;
+
+		~GrowableRegion() {
+			// Unmap both mapped chunks and the reserved range
+			munmap(start_ptr_, reserve_size_);
+			close(fd_);
+			if (remove_on_close) {
+				std::filesystem::remove(file_path_);
+			}
+		}
+
+	public:
+		/*!
+		 * @brief Make sure at least size bytes are mapped, growing by whole chunks.
+		 * Concurrent growers are serialized, and readers are never blocked.
+		 * @return Whether the region is large enough. False if size exceeds the reservation or the file cannot be extended.
+		 */
+		bool grow(size_t size) {
+			if (size <= mapped_size_.load(std::memory_order::acquire)) {
+				return true;
+			}
+
+			std::lock_guard<std::mutex> lock(grow_mutex_);
+			size_t old_size = mapped_size_.load(std::memory_order::relaxed);
+			if (size <= old_size) {
+				return true;
+			}
+
+			size_t new_size = round_up(size, chunk_size_);
+			if (new_size > reserve_size_) {
+				return false;
+			}
+
+			// Allocate blocks in advance, so that writes never hit SIGBUS for lack of space
+			struct stat file_stat{};
+			fstat(fd_, &file_stat);
+			if (static_cast<size_t>(file_stat.st_size) < new_size) {
+				if (posix_fallocate(fd_, 0, new_size) != 0 && ftruncate(fd_, new_size) != 0) {
+					return false;
+				}
+			}
+
+			bool map_sync;
+			void *res = map_file_fixed(start_ptr_ + old_size, fd_, old_size, new_size - old_size, option_, map_sync);
+			if (res == MAP_FAILED) {
+				return false;
+			}
+			// A chunk falling back to mapping without MAP_SYNC needs msync, so does the whole region
+			map_sync_.store(map_sync_.load(std::memory_order::relaxed) && map_sync, std::memory_order::release);
+
+			mapped_size_.store(new_size, std::memory_order::release);
+			return true;
+		}
+
+		/*!
+		 * @brief Grow the region by one chunk beyond the size seen by the caller
+		 */
+		bool grow_chunk() {
+			return grow(get_mapped_size() + chunk_size_);
+		}
+
+		[[nodiscard]] uint8_t *get_start_ptr() const {
+			return start_ptr_;
+		}
+
+		/*!
+		 * @brief Get the size of accessible range
+		 */
+		[[nodiscard]] size_t get_mapped_size() const {
+			return mapped_size_.load(std::memory_order::acquire);
+		}
+
+		[[nodiscard]] size_t get_reserve_size() const {
+			return reserve_size_;
+		}
+
+		[[nodiscard]] bool contains(const void *ptr) const {
+			auto *byte_ptr = static_cast<const uint8_t *>(ptr);
+			return byte_ptr >= start_ptr_ && byte_ptr < start_ptr_ + get_mapped_size();
+		}
+
+		/*!
+		 * @brief Whether every mapped chunk has MAP_SYNC, so that msync is unnecessary for the whole region
+		 */
+		[[nodiscard]] bool is_map_sync() const {
+			return map_sync_.load(std::memory_order::acquire);
+		}
+
+		[[nodiscard]] const std::filesystem::path &get_file_path() const {
+			return file_path_;
+		}
+
+	private:
+		static size_t round_up(size_t size, size_t unit) {
+			return (size + unit - 1) / unit * unit;
+		}
+	};
+
+}
+
+#endif //UTIL_MEM_GROWABLE_REGION_H
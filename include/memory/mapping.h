@@ -0,0 +1,189 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/1
+ */
+
+#pragma once
+#ifndef UTIL_MEM_MAPPING_H
+#define UTIL_MEM_MAPPING_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <sys/mman.h>
+
+#include <util/utility_macro.h>
+#include <memory/memory_config.h>
+
+#ifndef MAP_SHARED_VALIDATE
+	#define MAP_SHARED_VALIDATE 0x03
+#endif
+
+#ifndef MAP_SYNC
+	#define MAP_SYNC 0x80000
+#endif
+
+inline namespace util_mem {
+
+	constexpr size_t HUGE_PAGE_2M_SIZE = 2_MB;
+
+	constexpr size_t HUGE_PAGE_1G_SIZE = 1_GB;
+
+	/*!
+	 * @brief Options to map a file
+	 */
+	struct MapOption {
+		/// Map with MAP_SHARED_VALIDATE | MAP_SYNC, so that flushes of cpu are enough for durability on DAX
+		bool sync          = false;
+		/// Fall back to MAP_SHARED if MAP_SYNC is not supported (e.g. the file system isn't DAX)
+		bool sync_fallback = true;
+		/// Fault in all pages at mapping serially. Disable it to map lazily, and pre-fault in parallel by prefault_file() (prefault.h)
+		bool populate      = true;
+		/// Alignment of the mapping (e.g. 2 MiB or 1 GiB for huge pages), 0 for the default page alignment
+		size_t alignment   = 0;
+	};
+
+	/*!
+	 * @brief Page sizes of a mapping, parsed from /proc/self/smaps
+	 */
+	struct MappingPageInfo {
+		/// Whether the mapping has been found
+		bool found;
+		/// Resident size in KiB
+		uint64_t rss_kb;
+		/// Size mapped by PMD/PUD (huge pages) in KiB, for anonymous, shmem and file mappings
+		uint64_t huge_mapped_kb;
+		/// Page size used by MMU in KiB
+		uint64_t mmu_page_size_kb;
+
+		[[nodiscard]] bool has_huge_page() const {
+			return huge_mapped_kb > 0 || mmu_page_size_kb > MEM_PAGE_SIZE / 1_KB;
+		}
+	};
+
+	/*!
+	 * @brief Reserve an address range aligned to alignment, which is inaccessible until mapped by MAP_FIXED.
+	 * @return The aligned start, or MAP_FAILED
+	 */
+	inline void *reserve_aligned_range(size_t size, size_t alignment) {
+		if (alignment <= MEM_PAGE_SIZE) {
+			return mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		}
+
+		size_t reserve_size = size + alignment;
+		auto *reserve_ptr   = static_cast<uint8_t *>(mmap(nullptr, reserve_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+		if (reserve_ptr == MAP_FAILED) {
+			return MAP_FAILED;
+		}
+
+		// Release the excess before and after the aligned range
+		auto *aligned_ptr = reinterpret_cast<uint8_t *>(util_macro::ceil_2pow(reinterpret_cast<uintptr_t>(reserve_ptr), alignment));
+		size_t front_size = aligned_ptr - reserve_ptr;
+		size_t back_size  = reserve_size - front_size - size;
+		if (front_size > 0) {
+			munmap(reserve_ptr, front_size);
+		}
+		if (back_size > 0) {
+			munmap(aligned_ptr + size, back_size);
+		}
+		return aligned_ptr;
+	}
+
+	/*!
+	 * @brief Map a part of file in place of a reserved range, with given options.
+	 * @param addr The start of reserved range, which is replaced by MAP_FIXED
+	 * @param fd The file descriptor
+	 * @param offset The offset of file, aligned to page
+	 * @param size The size to map
+	 * @param option Options of mapping (alignment is ignored)
+	 * @param[out] map_sync Whether MAP_SYNC is in effect
+	 * @return The start of mapping, or MAP_FAILED, in which case the range keeps reserved
+	 */
+	inline void *map_file_fixed(void *addr, int fd, size_t offset, size_t size, const MapOption &option, bool &map_sync) {
+		int flags = MAP_FIXED | (option.populate ? MAP_POPULATE : 0);
+		void *res = MAP_FAILED;
+
+		map_sync = false;
+		if (option.sync) {
+			res = mmap(addr, size, PROT_READ | PROT_WRITE, flags | MAP_SHARED_VALIDATE | MAP_SYNC, fd, offset);
+			if (res != MAP_FAILED) {
+				map_sync = true;
+				return res;
+			}
+			if (!option.sync_fallback || (errno != EOPNOTSUPP && errno != EINVAL)) {
+				return MAP_FAILED;
+			}
+		}
+
+		return mmap(addr, size, PROT_READ | PROT_WRITE, flags | MAP_SHARED, fd, offset);
+	}
+
+	/*!
+	 * @brief Map a file in shared mode with given options.
+	 * The range is reserved with the requested alignment first and then mapped in place by MAP_FIXED,
+	 * so that the kernel is able to map it with huge pages.
+	 * @param fd The file descriptor
+	 * @param size The size to map from offset 0
+	 * @param option Options of mapping
+	 * @param[out] map_sync Whether MAP_SYNC is in effect
+	 * @return The start of mapping, or MAP_FAILED
+	 */
+	inline void *map_file(int fd, size_t size, const MapOption &option, bool &map_sync) {
+		void *addr = reserve_aligned_range(size, option.alignment);
+		if (addr == MAP_FAILED) {
+			return MAP_FAILED;
+		}
+
+		void *res = map_file_fixed(addr, fd, 0, size, option, map_sync);
+		if (res == MAP_FAILED) {
+			munmap(addr, size);
+		}
+		return res;
+	}
+
+	/*!
+	 * @brief Find the mapping containing ptr in /proc/self/smaps and report its page sizes
+	 */
+	inline MappingPageInfo get_mapping_page_info(const void *ptr) {
+		MappingPageInfo info{false, 0, 0, 0};
+		auto target = reinterpret_cast<uintptr_t>(ptr);
+
+		std::ifstream smaps("/proc/self/smaps");
+		std::string line;
+		bool in_target = false;
+		while (std::getline(smaps, line)) {
+			uintptr_t begin, end;
+			// Header of mapping: "begin-end perms offset dev inode path"
+			if (std::sscanf(line.c_str(), "%lx-%lx ", &begin, &end) == 2 && line.find(':') > line.find(' ')) {
+				if (in_target) { break; }
+				in_target = target >= begin && target < end;
+				info.found |= in_target;
+				continue;
+			}
+			if (!in_target) { continue; }
+
+			std::istringstream line_stream(line);
+			std::string key;
+			uint64_t value;
+			if (!(line_stream >> key >> value)) { continue; }
+
+			if (key == "Rss:") {
+				info.rss_kb = value;
+			}
+			else if (key == "AnonHugePages:" || key == "ShmemPmdMapped:" || key == "FilePmdMapped:") {
+				info.huge_mapped_kb += value;
+			}
+			else if (key == "MMUPageSize:") {
+				info.mmu_page_size_kb = value;
+			}
+		}
+		return info;
+	}
+
+}
+
+#endif //UTIL_MEM_MAPPING_H
@@ -9,10 +9,16 @@
 
 #include <memory/cache_config.h>
 #include <memory/flush.h>
+#include <memory/flush_detect.h>
+#include <memory/persist_stats.h>
 #include <memory/prefetch.h>
 #include <memory/ntstore.h>
+#include <memory/persist.h>
 #include <memory/memory_config.h>
 #include <memory/nvm_config.h>
+#include <memory/flush_set.h>
 #include <memory/file_descriptor.h>
+#include <memory/persistent_ptr.h>
+#include <memory/arena.h>
 
 #endif //UTIL_MEM_MEMORY_H
@@ -7,12 +7,19 @@
 #ifndef UTIL_MEM_NTSTORE_H
 #define UTIL_MEM_NTSTORE_H
 
+#include <cassert>
 #include <cstdint>
 #include <cstring>
 #include <immintrin.h>
 
+#include <arch/cpu_feature.h>
 #include <util/utility_macro.h>
 #include <memory/cache_config.h>
+#include <memory/prefetch.h>
+#include <memory/persist_stats.h>
+#include <memory/ntstore_common.h>
+#include <memory/ntstore_avx2.h>
+#include <memory/ntstore_avx512f.h>
 
 namespace util_mem {
 	static inline __m128i mm_loadu_si128(const uint8_t *src, unsigned idx) {
@@ -122,10 +129,7 @@ namespace util_mem {
 			if (cnt > len)
 				cnt = len;
 
-			std::memmove(dest, src, len);
-			for (size_t i = 0; i < len; i += CACHE_LINE_SIZE) {
-				_mm_clflushopt(dest + i);
-			}
+			memmove_small_flush(dest, src, cnt);
 
 			dest += cnt;
 			src += cnt;
@@ -198,10 +202,7 @@ namespace util_mem {
 		}
 
 		nonnt:
-			std::memcpy(dest, src, len);
-			for (size_t i = 0; i < len; i += CACHE_LINE_SIZE) {
-				_mm_clflushopt(dest + i);
-			}
+			memmove_small_flush(dest, src, len);
 	}
 
 	static inline void
@@ -218,10 +219,7 @@ namespace util_mem {
 			src -= cnt;
 			len -= cnt;
 
-			std::memmove(dest, src, len);
-			for (size_t i = 0; i < len; i += CACHE_LINE_SIZE) {
-				_mm_clflushopt(dest + i);
-			}
+			memmove_small_flush(dest, src, cnt);
 		}
 
 		const uint8_t *srcbegin = src - len;
@@ -304,10 +302,7 @@ namespace util_mem {
 		nonnt:
 			dest -= len;
 			src -= len;
-			std::memcpy(dest, src, len);
-			for (size_t i = 0; i < len; i += CACHE_LINE_SIZE) {
-				_mm_clflushopt(dest + i);
-			}
+			memmove_small_flush(dest, src, len);
 	}
 
 	static inline void memmove_movnt_sse2(uint8_t *dest, const uint8_t *src, size_t len) {
@@ -418,10 +413,7 @@ namespace util_mem {
 			if (cnt > len)
 				cnt = len;
 
-			std::memcpy(dest, src, len);
-			for (size_t i = 0; i < len; i += CACHE_LINE_SIZE) {
-				_mm_clflushopt(dest + i);
-			}
+			memcpy_small_flush(dest, src, cnt);
 
 			dest += cnt;
 			src += cnt;
@@ -494,16 +486,239 @@ namespace util_mem {
 		}
 
 		nonnt:
-		std::memcpy(dest, src, len);
-		for (size_t i = 0; i < len; i += CACHE_LINE_SIZE) {
-			_mm_clflushopt(dest + i);
-		}
+		memcpy_small_flush(dest, src, len);
 	}
 
 
 	static inline void memcpy_movnt_sse2(uint8_t * __restrict dest, const uint8_t * __restrict src, size_t len) {
 		memcpy_movnt_sse_fw(dest, src, len);
 	}
+
+	static inline void memset_movnt4x64b(uint8_t *dest, __m128i xmm) {
+		mm_stream_si128(dest, 0, xmm);
+		mm_stream_si128(dest, 1, xmm);
+		mm_stream_si128(dest, 2, xmm);
+		mm_stream_si128(dest, 3, xmm);
+		mm_stream_si128(dest, 4, xmm);
+		mm_stream_si128(dest, 5, xmm);
+		mm_stream_si128(dest, 6, xmm);
+		mm_stream_si128(dest, 7, xmm);
+		mm_stream_si128(dest, 8, xmm);
+		mm_stream_si128(dest, 9, xmm);
+		mm_stream_si128(dest, 10, xmm);
+		mm_stream_si128(dest, 11, xmm);
+		mm_stream_si128(dest, 12, xmm);
+		mm_stream_si128(dest, 13, xmm);
+		mm_stream_si128(dest, 14, xmm);
+		mm_stream_si128(dest, 15, xmm);
+	}
+
+	static inline void memset_movnt2x64b(uint8_t *dest, __m128i xmm) {
+		mm_stream_si128(dest, 0, xmm);
+		mm_stream_si128(dest, 1, xmm);
+		mm_stream_si128(dest, 2, xmm);
+		mm_stream_si128(dest, 3, xmm);
+		mm_stream_si128(dest, 4, xmm);
+		mm_stream_si128(dest, 5, xmm);
+		mm_stream_si128(dest, 6, xmm);
+		mm_stream_si128(dest, 7, xmm);
+	}
+
+	static inline void memset_movnt1x64b(uint8_t *dest, __m128i xmm) {
+		mm_stream_si128(dest, 0, xmm);
+		mm_stream_si128(dest, 1, xmm);
+		mm_stream_si128(dest, 2, xmm);
+		mm_stream_si128(dest, 3, xmm);
+	}
+
+	static inline void memset_movnt1x32b(uint8_t *dest, __m128i xmm) {
+		mm_stream_si128(dest, 0, xmm);
+		mm_stream_si128(dest, 1, xmm);
+	}
+
+	static inline void memset_movnt1x16b(uint8_t *dest, __m128i xmm) {
+		mm_stream_si128(dest, 0, xmm);
+	}
+
+	static inline void memset_movnt1x8b(uint8_t *dest, __m128i xmm) {
+		_mm_stream_si64((long long *)dest, _mm_cvtsi128_si64(xmm));
+	}
+
+	static inline void memset_movnt1x4b(uint8_t *dest, __m128i xmm) {
+		_mm_stream_si32((int *)dest, _mm_cvtsi128_si32(xmm));
+	}
+
+	static inline void memset_movnt_sse_fw(uint8_t *dest, int c, size_t len) {
+		__m128i xmm = _mm_set1_epi8((char)c);
+
+		size_t cnt = (uint64_t)dest & 63;
+		if (cnt > 0) {
+			cnt = 64 - cnt;
+
+			if (cnt > len)
+				cnt = len;
+
+			memset_small_flush(dest, c, cnt);
+
+			dest += cnt;
+			len -= cnt;
+		}
+
+		while (len >= PERF_BARRIER_SIZE) {
+			memset_movnt4x64b(dest, xmm);
+			dest += 4 * 64;
+			len -= 4 * 64;
+
+			memset_movnt4x64b(dest, xmm);
+			dest += 4 * 64;
+			len -= 4 * 64;
+
+			memset_movnt4x64b(dest, xmm);
+			dest += 4 * 64;
+			len -= 4 * 64;
+
+			static_assert(PERF_BARRIER_SIZE == (4 + 4 + 4) * 64);
+		}
+
+		while (len >= 4 * 64) {
+			memset_movnt4x64b(dest, xmm);
+			dest += 4 * 64;
+			len -= 4 * 64;
+		}
+
+		if (len >= 2 * 64) {
+			memset_movnt2x64b(dest, xmm);
+			dest += 2 * 64;
+			len -= 2 * 64;
+		}
+
+		if (len >= 1 * 64) {
+			memset_movnt1x64b(dest, xmm);
+			dest += 1 * 64;
+			len -= 1 * 64;
+		}
+
+		if (len == 0)
+			return;
+
+		/* There's no point in using more than 1 nt store for 1 cache line. */
+		if (util_macro::is_2pow(len)) {
+			if (len == 32)
+				memset_movnt1x32b(dest, xmm);
+			else if (len == 16)
+				memset_movnt1x16b(dest, xmm);
+			else if (len == 8)
+				memset_movnt1x8b(dest, xmm);
+			else if (len == 4)
+				memset_movnt1x4b(dest, xmm);
+			else
+				goto nonnt;
+
+			return;
+		}
+
+		nonnt:
+		memset_small_flush(dest, c, len);
+	}
+
+	static inline void memset_movnt_sse2(uint8_t *dest, int c, size_t len) {
+		memset_movnt_sse_fw(dest, c, len);
+	}
+
+	/*
+	 * Runtime dispatch among SSE2/AVX2/AVX-512F kernels
+	 */
+
+	enum class NTStoreISA {
+		SSE2,
+		AVX2,
+		AVX512F
+	};
+
+	using memmove_movnt_func = void (*)(uint8_t *, const uint8_t *, size_t);
+	using memcpy_movnt_func  = void (*)(uint8_t * __restrict, const uint8_t * __restrict, size_t);
+	using memset_movnt_func  = void (*)(uint8_t *, int, size_t);
+
+	struct NTStoreKernel {
+		/// The instruction set of the kernel
+		NTStoreISA isa;
+		/// Non-temporal memmove
+		memmove_movnt_func memmove;
+		/// Non-temporal memcpy
+		memcpy_movnt_func memcpy;
+		/// Non-temporal memset
+		memset_movnt_func memset;
+	};
+
+	/*!
+	 * @brief Whether the running cpu supports kernels of the instruction set
+	 */
+	inline bool is_ntstore_isa_supported(NTStoreISA isa) {
+		const CPUFeature &feature = get_cpu_feature();
+		switch (isa) {
+			case NTStoreISA::AVX512F:
+				return feature.avx512f;
+			case NTStoreISA::AVX2:
+				return feature.avx2;
+			default:
+				return true;
+		}
+	}
+
+	/*!
+	 * @brief Get kernels of specific instruction set, e.g. to test narrower kernels on a wider cpu.
+	 * The instruction set should be supported by the running cpu.
+	 */
+	inline NTStoreKernel select_ntstore_kernel(NTStoreISA isa) {
+		assert(is_ntstore_isa_supported(isa));
+		switch (isa) {
+			case NTStoreISA::AVX512F:
+				return { NTStoreISA::AVX512F, memmove_movnt_avx512f, memcpy_movnt_avx512f, memset_movnt_avx512f };
+			case NTStoreISA::AVX2:
+				return { NTStoreISA::AVX2, memmove_movnt_avx2, memcpy_movnt_avx2, memset_movnt_avx2 };
+			default:
+				return { NTStoreISA::SSE2, memmove_movnt_sse2, memcpy_movnt_sse2, memset_movnt_sse2 };
+		}
+	}
+
+	/*!
+	 * @brief Choose the widest kernel supported by the running cpu.
+	 */
+	inline NTStoreKernel select_ntstore_kernel() {
+		for (NTStoreISA isa: { NTStoreISA::AVX512F, NTStoreISA::AVX2 }) {
+			if (is_ntstore_isa_supported(isa)) {
+				return select_ntstore_kernel(isa);
+			}
+		}
+		return select_ntstore_kernel(NTStoreISA::SSE2);
+	}
+
+	/*!
+	 * @brief Get the kernel chosen for the running cpu, which is probed only once.
+	 */
+	inline const NTStoreKernel &get_ntstore_kernel() {
+		static const NTStoreKernel kernel = select_ntstore_kernel();
+		return kernel;
+	}
+
+	/*
+	 * Entry points of the kernel chosen for the running cpu. The misaligned head and tail are flushed
+	 * by NVMRuntime regardless of the caller's policy (see ntstore_common.h).
+	 */
+	static inline void memmove_movnt(uint8_t *dest, const uint8_t *src, size_t len) {
+		get_ntstore_kernel().memmove(dest, src, len);
+		persist_stat_add_nt_bytes(len);
+	}
+
+	static inline void memcpy_movnt(uint8_t * __restrict dest, const uint8_t * __restrict src, size_t len) {
+		get_ntstore_kernel().memcpy(dest, src, len);
+		persist_stat_add_nt_bytes(len);
+	}
+
+	static inline void memset_movnt(uint8_t *dest, int c, size_t len) {
+		get_ntstore_kernel().memset(dest, c, len);
+		persist_stat_add_nt_bytes(len);
+	}
 }
 
 #endif //UTIL_MEM_NTSTORE_H
@@ -0,0 +1,586 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/6/24
+ */
+
+#pragma once
+#ifndef UTIL_MEM_NTSTORE_AVX2_H
+#define UTIL_MEM_NTSTORE_AVX2_H
+
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+#include <util/utility_macro.h>
+#include <memory/cache_config.h>
+#include <memory/prefetch.h>
+#include <memory/ntstore_common.h>
+
+/*
+ * AVX2 variants of non-temporal kernels in ntstore.h.
+ * They are compiled for avx2 by function attribute so that the binary can be
+ * built for baseline x86-64 and choose them at runtime (see memcpy_movnt()).
+ */
+
+namespace util_mem {
+	__attribute__((target("avx2")))
+	static inline __m256i mm256_loadu_si256(const uint8_t *src, unsigned idx) {
+		return _mm256_loadu_si256((const __m256i *)src + idx);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void mm256_stream_si256(uint8_t *dest, unsigned idx, __m256i src) {
+		_mm256_stream_si256((__m256i *)dest + idx, src);
+		asm volatile("" ::: "memory");
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memmove_movnt4x64b_avx2(uint8_t *dest, const uint8_t *src) {
+		__m256i ymm0 = mm256_loadu_si256(src, 0);
+		__m256i ymm1 = mm256_loadu_si256(src, 1);
+		__m256i ymm2 = mm256_loadu_si256(src, 2);
+		__m256i ymm3 = mm256_loadu_si256(src, 3);
+		__m256i ymm4 = mm256_loadu_si256(src, 4);
+		__m256i ymm5 = mm256_loadu_si256(src, 5);
+		__m256i ymm6 = mm256_loadu_si256(src, 6);
+		__m256i ymm7 = mm256_loadu_si256(src, 7);
+
+		mm256_stream_si256(dest, 0, ymm0);
+		mm256_stream_si256(dest, 1, ymm1);
+		mm256_stream_si256(dest, 2, ymm2);
+		mm256_stream_si256(dest, 3, ymm3);
+		mm256_stream_si256(dest, 4, ymm4);
+		mm256_stream_si256(dest, 5, ymm5);
+		mm256_stream_si256(dest, 6, ymm6);
+		mm256_stream_si256(dest, 7, ymm7);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memmove_movnt2x64b_avx2(uint8_t *dest, const uint8_t *src) {
+		__m256i ymm0 = mm256_loadu_si256(src, 0);
+		__m256i ymm1 = mm256_loadu_si256(src, 1);
+		__m256i ymm2 = mm256_loadu_si256(src, 2);
+		__m256i ymm3 = mm256_loadu_si256(src, 3);
+
+		mm256_stream_si256(dest, 0, ymm0);
+		mm256_stream_si256(dest, 1, ymm1);
+		mm256_stream_si256(dest, 2, ymm2);
+		mm256_stream_si256(dest, 3, ymm3);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memmove_movnt1x64b_avx2(uint8_t *dest, const uint8_t *src) {
+		__m256i ymm0 = mm256_loadu_si256(src, 0);
+		__m256i ymm1 = mm256_loadu_si256(src, 1);
+
+		mm256_stream_si256(dest, 0, ymm0);
+		mm256_stream_si256(dest, 1, ymm1);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memmove_movnt1x32b_avx2(uint8_t *dest, const uint8_t *src) {
+		__m256i ymm0 = mm256_loadu_si256(src, 0);
+
+		mm256_stream_si256(dest, 0, ymm0);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memmove_movnt1x16b_avx2(uint8_t *dest, const uint8_t *src) {
+		__m128i xmm0 = _mm_loadu_si128((const __m128i *)src);
+
+		_mm_stream_si128((__m128i *)dest, xmm0);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memmove_movnt1x8b_avx2(uint8_t *dest, const uint8_t *src) {
+		_mm_stream_si64((long long *)dest, *(long long *)src);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memmove_movnt1x4b_avx2(uint8_t *dest, const uint8_t *src) {
+		_mm_stream_si32((int *)dest, *(int *)src);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memmove_movnt_avx_fw(uint8_t *dest, const uint8_t *src, size_t len) {
+		size_t cnt = (uint64_t)dest & 63;
+		if (cnt > 0) {
+			cnt = 64 - cnt;
+
+			if (cnt > len)
+				cnt = len;
+
+			memmove_small_flush(dest, src, cnt);
+
+			dest += cnt;
+			src += cnt;
+			len -= cnt;
+		}
+
+		const uint8_t *srcend = src + len;
+		prefetch_ini_fw(src, len);
+
+		while (len >= PERF_BARRIER_SIZE) {
+			prefetch_next_fw(src, srcend);
+
+			memmove_movnt4x64b_avx2(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+
+			memmove_movnt4x64b_avx2(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+
+			memmove_movnt4x64b_avx2(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+
+			static_assert(PERF_BARRIER_SIZE == (4 + 4 + 4) * 64);
+		}
+
+		while (len >= 4 * 64) {
+			memmove_movnt4x64b_avx2(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+		}
+
+		if (len >= 2 * 64) {
+			memmove_movnt2x64b_avx2(dest, src);
+			dest += 2 * 64;
+			src += 2 * 64;
+			len -= 2 * 64;
+		}
+
+		if (len >= 1 * 64) {
+			memmove_movnt1x64b_avx2(dest, src);
+
+			dest += 1 * 64;
+			src += 1 * 64;
+			len -= 1 * 64;
+		}
+
+		if (len == 0)
+			return;
+
+		/* There's no point in using more than 1 nt store for 1 cache line. */
+		if (util_macro::is_2pow(len)) {
+			if (len == 32)
+				memmove_movnt1x32b_avx2(dest, src);
+			else if (len == 16)
+				memmove_movnt1x16b_avx2(dest, src);
+			else if (len == 8)
+				memmove_movnt1x8b_avx2(dest, src);
+			else if (len == 4)
+				memmove_movnt1x4b_avx2(dest, src);
+			else
+				goto nonnt;
+
+			return;
+		}
+
+		nonnt:
+			memmove_small_flush(dest, src, len);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void
+	memmove_movnt_avx_bw(uint8_t *dest, const uint8_t *src, size_t len) {
+		dest += len;
+		src += len;
+
+		size_t cnt = (uint64_t)dest & 63;
+		if (cnt > 0) {
+			if (cnt > len)
+				cnt = len;
+
+			dest -= cnt;
+			src -= cnt;
+			len -= cnt;
+
+			memmove_small_flush(dest, src, cnt);
+		}
+
+		const uint8_t *srcbegin = src - len;
+		prefetch_ini_bw(src, len);
+
+		while (len >= PERF_BARRIER_SIZE) {
+			prefetch_next_bw(src, srcbegin);
+
+			dest -= 4 * 64;
+			src -= 4 * 64;
+			len -= 4 * 64;
+			memmove_movnt4x64b_avx2(dest, src);
+
+			dest -= 4 * 64;
+			src -= 4 * 64;
+			len -= 4 * 64;
+			memmove_movnt4x64b_avx2(dest, src);
+
+			dest -= 4 * 64;
+			src -= 4 * 64;
+			len -= 4 * 64;
+			memmove_movnt4x64b_avx2(dest, src);
+
+			static_assert(PERF_BARRIER_SIZE == (4 + 4 + 4) * 64);
+		}
+
+		while (len >= 4 * 64) {
+			dest -= 4 * 64;
+			src -= 4 * 64;
+			len -= 4 * 64;
+			memmove_movnt4x64b_avx2(dest, src);
+		}
+
+		if (len >= 2 * 64) {
+			dest -= 2 * 64;
+			src -= 2 * 64;
+			len -= 2 * 64;
+			memmove_movnt2x64b_avx2(dest, src);
+		}
+
+		if (len >= 1 * 64) {
+			dest -= 1 * 64;
+			src -= 1 * 64;
+			len -= 1 * 64;
+			memmove_movnt1x64b_avx2(dest, src);
+		}
+
+		if (len == 0)
+			return;
+
+		/* There's no point in using more than 1 nt store for 1 cache line. */
+		if (util_macro::is_2pow(len)) {
+			if (len == 32) {
+				dest -= 32;
+				src -= 32;
+				memmove_movnt1x32b_avx2(dest, src);
+			}
+			else if (len == 16) {
+				dest -= 16;
+				src -= 16;
+				memmove_movnt1x16b_avx2(dest, src);
+			}
+			else if (len == 8) {
+				dest -= 8;
+				src -= 8;
+				memmove_movnt1x8b_avx2(dest, src);
+			}
+			else if (len == 4) {
+				dest -= 4;
+				src -= 4;
+				memmove_movnt1x4b_avx2(dest, src);
+			}
+			else {
+				goto nonnt;
+			}
+
+			return;
+		}
+
+		nonnt:
+			dest -= len;
+			src -= len;
+			memmove_small_flush(dest, src, len);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memmove_movnt_avx2(uint8_t *dest, const uint8_t *src, size_t len) {
+		if ((uintptr_t)dest - (uintptr_t)src >= len) {
+			memmove_movnt_avx_fw(dest, src, len);
+		}
+		else {
+			memmove_movnt_avx_bw(dest, src, len);
+		}
+		_mm256_zeroupper();
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memcpy_movnt4x64b_avx2(uint8_t * __restrict dest, const uint8_t * __restrict src) {
+		__m256i ymm0 = mm256_loadu_si256(src, 0);
+		__m256i ymm1 = mm256_loadu_si256(src, 1);
+		__m256i ymm2 = mm256_loadu_si256(src, 2);
+		__m256i ymm3 = mm256_loadu_si256(src, 3);
+		__m256i ymm4 = mm256_loadu_si256(src, 4);
+		__m256i ymm5 = mm256_loadu_si256(src, 5);
+		__m256i ymm6 = mm256_loadu_si256(src, 6);
+		__m256i ymm7 = mm256_loadu_si256(src, 7);
+
+		mm256_stream_si256(dest, 0, ymm0);
+		mm256_stream_si256(dest, 1, ymm1);
+		mm256_stream_si256(dest, 2, ymm2);
+		mm256_stream_si256(dest, 3, ymm3);
+		mm256_stream_si256(dest, 4, ymm4);
+		mm256_stream_si256(dest, 5, ymm5);
+		mm256_stream_si256(dest, 6, ymm6);
+		mm256_stream_si256(dest, 7, ymm7);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memcpy_movnt2x64b_avx2(uint8_t * __restrict dest, const uint8_t * __restrict src) {
+		__m256i ymm0 = mm256_loadu_si256(src, 0);
+		__m256i ymm1 = mm256_loadu_si256(src, 1);
+		__m256i ymm2 = mm256_loadu_si256(src, 2);
+		__m256i ymm3 = mm256_loadu_si256(src, 3);
+
+		mm256_stream_si256(dest, 0, ymm0);
+		mm256_stream_si256(dest, 1, ymm1);
+		mm256_stream_si256(dest, 2, ymm2);
+		mm256_stream_si256(dest, 3, ymm3);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memcpy_movnt1x64b_avx2(uint8_t * __restrict dest, const uint8_t * __restrict src) {
+		__m256i ymm0 = mm256_loadu_si256(src, 0);
+		__m256i ymm1 = mm256_loadu_si256(src, 1);
+
+		mm256_stream_si256(dest, 0, ymm0);
+		mm256_stream_si256(dest, 1, ymm1);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memcpy_movnt1x32b_avx2(uint8_t * __restrict dest, const uint8_t * __restrict src) {
+		__m256i ymm0 = mm256_loadu_si256(src, 0);
+
+		mm256_stream_si256(dest, 0, ymm0);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memcpy_movnt1x16b_avx2(uint8_t * __restrict dest, const uint8_t * __restrict src) {
+		__m128i xmm0 = _mm_loadu_si128((const __m128i *)src);
+
+		_mm_stream_si128((__m128i *)dest, xmm0);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memcpy_movnt1x8b_avx2(uint8_t * __restrict dest, const uint8_t * __restrict src) {
+		_mm_stream_si64((long long *)dest, *(long long *)src);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memcpy_movnt1x4b_avx2(uint8_t * __restrict dest, const uint8_t * __restrict src) {
+		_mm_stream_si32((int *)dest, *(int *)src);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memcpy_movnt_avx_fw(uint8_t * __restrict dest, const uint8_t * __restrict src, size_t len) {
+		size_t cnt = (uint64_t)dest & 63;
+		if (cnt > 0) {
+			cnt = 64 - cnt;
+
+			if (cnt > len)
+				cnt = len;
+
+			memcpy_small_flush(dest, src, cnt);
+
+			dest += cnt;
+			src += cnt;
+			len -= cnt;
+		}
+
+		const uint8_t *srcend = src + len;
+		prefetch_ini_fw(src, len);
+
+		while (len >= PERF_BARRIER_SIZE) {
+			prefetch_next_fw(src, srcend);
+
+			memcpy_movnt4x64b_avx2(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+
+			memcpy_movnt4x64b_avx2(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+
+			memcpy_movnt4x64b_avx2(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+
+			static_assert(PERF_BARRIER_SIZE == (4 + 4 + 4) * 64);
+		}
+
+		while (len >= 4 * 64) {
+			memcpy_movnt4x64b_avx2(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+		}
+
+		if (len >= 2 * 64) {
+			memcpy_movnt2x64b_avx2(dest, src);
+			dest += 2 * 64;
+			src += 2 * 64;
+			len -= 2 * 64;
+		}
+
+		if (len >= 1 * 64) {
+			memcpy_movnt1x64b_avx2(dest, src);
+
+			dest += 1 * 64;
+			src += 1 * 64;
+			len -= 1 * 64;
+		}
+
+		if (len == 0)
+			return;
+
+		/* There's no point in using more than 1 nt store for 1 cache line. */
+		if (util_macro::is_2pow(len)) {
+			if (len == 32)
+				memcpy_movnt1x32b_avx2(dest, src);
+			else if (len == 16)
+				memcpy_movnt1x16b_avx2(dest, src);
+			else if (len == 8)
+				memcpy_movnt1x8b_avx2(dest, src);
+			else if (len == 4)
+				memcpy_movnt1x4b_avx2(dest, src);
+			else
+				goto nonnt;
+
+			return;
+		}
+
+		nonnt:
+		memcpy_small_flush(dest, src, len);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memcpy_movnt_avx2(uint8_t * __restrict dest, const uint8_t * __restrict src, size_t len) {
+		memcpy_movnt_avx_fw(dest, src, len);
+		_mm256_zeroupper();
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memset_movnt4x64b_avx2(uint8_t *dest, __m256i ymm) {
+		mm256_stream_si256(dest, 0, ymm);
+		mm256_stream_si256(dest, 1, ymm);
+		mm256_stream_si256(dest, 2, ymm);
+		mm256_stream_si256(dest, 3, ymm);
+		mm256_stream_si256(dest, 4, ymm);
+		mm256_stream_si256(dest, 5, ymm);
+		mm256_stream_si256(dest, 6, ymm);
+		mm256_stream_si256(dest, 7, ymm);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memset_movnt2x64b_avx2(uint8_t *dest, __m256i ymm) {
+		mm256_stream_si256(dest, 0, ymm);
+		mm256_stream_si256(dest, 1, ymm);
+		mm256_stream_si256(dest, 2, ymm);
+		mm256_stream_si256(dest, 3, ymm);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memset_movnt1x64b_avx2(uint8_t *dest, __m256i ymm) {
+		mm256_stream_si256(dest, 0, ymm);
+		mm256_stream_si256(dest, 1, ymm);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memset_movnt1x32b_avx2(uint8_t *dest, __m256i ymm) {
+		mm256_stream_si256(dest, 0, ymm);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memset_movnt1x16b_avx2(uint8_t *dest, __m256i ymm) {
+		_mm_stream_si128((__m128i *)dest, _mm256_castsi256_si128(ymm));
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memset_movnt1x8b_avx2(uint8_t *dest, __m256i ymm) {
+		_mm_stream_si64((long long *)dest, _mm_cvtsi128_si64(_mm256_castsi256_si128(ymm)));
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memset_movnt1x4b_avx2(uint8_t *dest, __m256i ymm) {
+		_mm_stream_si32((int *)dest, _mm_cvtsi128_si32(_mm256_castsi256_si128(ymm)));
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memset_movnt_avx_fw(uint8_t *dest, int c, size_t len) {
+		__m256i ymm = _mm256_set1_epi8((char)c);
+
+		size_t cnt = (uint64_t)dest & 63;
+		if (cnt > 0) {
+			cnt = 64 - cnt;
+
+			if (cnt > len)
+				cnt = len;
+
+			memset_small_flush(dest, c, cnt);
+
+			dest += cnt;
+			len -= cnt;
+		}
+
+		while (len >= PERF_BARRIER_SIZE) {
+			memset_movnt4x64b_avx2(dest, ymm);
+			dest += 4 * 64;
+			len -= 4 * 64;
+
+			memset_movnt4x64b_avx2(dest, ymm);
+			dest += 4 * 64;
+			len -= 4 * 64;
+
+			memset_movnt4x64b_avx2(dest, ymm);
+			dest += 4 * 64;
+			len -= 4 * 64;
+
+			static_assert(PERF_BARRIER_SIZE == (4 + 4 + 4) * 64);
+		}
+
+		while (len >= 4 * 64) {
+			memset_movnt4x64b_avx2(dest, ymm);
+			dest += 4 * 64;
+			len -= 4 * 64;
+		}
+
+		if (len >= 2 * 64) {
+			memset_movnt2x64b_avx2(dest, ymm);
+			dest += 2 * 64;
+			len -= 2 * 64;
+		}
+
+		if (len >= 1 * 64) {
+			memset_movnt1x64b_avx2(dest, ymm);
+			dest += 1 * 64;
+			len -= 1 * 64;
+		}
+
+		if (len == 0)
+			return;
+
+		/* There's no point in using more than 1 nt store for 1 cache line. */
+		if (util_macro::is_2pow(len)) {
+			if (len == 32)
+				memset_movnt1x32b_avx2(dest, ymm);
+			else if (len == 16)
+				memset_movnt1x16b_avx2(dest, ymm);
+			else if (len == 8)
+				memset_movnt1x8b_avx2(dest, ymm);
+			else if (len == 4)
+				memset_movnt1x4b_avx2(dest, ymm);
+			else
+				goto nonnt;
+
+			return;
+		}
+
+		nonnt:
+		memset_small_flush(dest, c, len);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void memset_movnt_avx2(uint8_t *dest, int c, size_t len) {
+		memset_movnt_avx_fw(dest, c, len);
+		_mm256_zeroupper();
+	}
+}
+
+#endif //UTIL_MEM_NTSTORE_AVX2_H
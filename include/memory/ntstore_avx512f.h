@@ -0,0 +1,564 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/6/24
+ */
+
+#pragma once
+#ifndef UTIL_MEM_NTSTORE_AVX512F_H
+#define UTIL_MEM_NTSTORE_AVX512F_H
+
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+#include <util/utility_macro.h>
+#include <memory/cache_config.h>
+#include <memory/prefetch.h>
+#include <memory/ntstore_common.h>
+
+/*
+ * AVX-512F variants of non-temporal kernels in ntstore.h.
+ * They are compiled for avx512f by function attribute so that the binary can be
+ * built for baseline x86-64 and choose them at runtime (see memcpy_movnt()).
+ */
+
+namespace util_mem {
+	__attribute__((target("avx512f")))
+	static inline __m512i mm512_loadu_si512(const uint8_t *src, unsigned idx) {
+		return _mm512_loadu_si512((const __m512i *)src + idx);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void mm512_stream_si512(uint8_t *dest, unsigned idx, __m512i src) {
+		_mm512_stream_si512((__m512i *)dest + idx, src);
+		asm volatile("" ::: "memory");
+	}
+
+	__attribute__((target("avx512f")))
+	static inline __m256i mm256_loadu_si256_avx512f(const uint8_t *src, unsigned idx) {
+		return _mm256_loadu_si256((const __m256i *)src + idx);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void mm256_stream_si256_avx512f(uint8_t *dest, unsigned idx, __m256i src) {
+		_mm256_stream_si256((__m256i *)dest + idx, src);
+		asm volatile("" ::: "memory");
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memmove_movnt4x64b_avx512f(uint8_t *dest, const uint8_t *src) {
+		__m512i zmm0 = mm512_loadu_si512(src, 0);
+		__m512i zmm1 = mm512_loadu_si512(src, 1);
+		__m512i zmm2 = mm512_loadu_si512(src, 2);
+		__m512i zmm3 = mm512_loadu_si512(src, 3);
+
+		mm512_stream_si512(dest, 0, zmm0);
+		mm512_stream_si512(dest, 1, zmm1);
+		mm512_stream_si512(dest, 2, zmm2);
+		mm512_stream_si512(dest, 3, zmm3);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memmove_movnt2x64b_avx512f(uint8_t *dest, const uint8_t *src) {
+		__m512i zmm0 = mm512_loadu_si512(src, 0);
+		__m512i zmm1 = mm512_loadu_si512(src, 1);
+
+		mm512_stream_si512(dest, 0, zmm0);
+		mm512_stream_si512(dest, 1, zmm1);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memmove_movnt1x64b_avx512f(uint8_t *dest, const uint8_t *src) {
+		__m512i zmm0 = mm512_loadu_si512(src, 0);
+
+		mm512_stream_si512(dest, 0, zmm0);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memmove_movnt1x32b_avx512f(uint8_t *dest, const uint8_t *src) {
+		__m256i ymm0 = mm256_loadu_si256_avx512f(src, 0);
+
+		mm256_stream_si256_avx512f(dest, 0, ymm0);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memmove_movnt1x16b_avx512f(uint8_t *dest, const uint8_t *src) {
+		__m128i xmm0 = _mm_loadu_si128((const __m128i *)src);
+
+		_mm_stream_si128((__m128i *)dest, xmm0);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memmove_movnt1x8b_avx512f(uint8_t *dest, const uint8_t *src) {
+		_mm_stream_si64((long long *)dest, *(long long *)src);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memmove_movnt1x4b_avx512f(uint8_t *dest, const uint8_t *src) {
+		_mm_stream_si32((int *)dest, *(int *)src);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memmove_movnt_avx512f_fw(uint8_t *dest, const uint8_t *src, size_t len) {
+		size_t cnt = (uint64_t)dest & 63;
+		if (cnt > 0) {
+			cnt = 64 - cnt;
+
+			if (cnt > len)
+				cnt = len;
+
+			memmove_small_flush(dest, src, cnt);
+
+			dest += cnt;
+			src += cnt;
+			len -= cnt;
+		}
+
+		const uint8_t *srcend = src + len;
+		prefetch_ini_fw(src, len);
+
+		while (len >= PERF_BARRIER_SIZE) {
+			prefetch_next_fw(src, srcend);
+
+			memmove_movnt4x64b_avx512f(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+
+			memmove_movnt4x64b_avx512f(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+
+			memmove_movnt4x64b_avx512f(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+
+			static_assert(PERF_BARRIER_SIZE == (4 + 4 + 4) * 64);
+		}
+
+		while (len >= 4 * 64) {
+			memmove_movnt4x64b_avx512f(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+		}
+
+		if (len >= 2 * 64) {
+			memmove_movnt2x64b_avx512f(dest, src);
+			dest += 2 * 64;
+			src += 2 * 64;
+			len -= 2 * 64;
+		}
+
+		if (len >= 1 * 64) {
+			memmove_movnt1x64b_avx512f(dest, src);
+
+			dest += 1 * 64;
+			src += 1 * 64;
+			len -= 1 * 64;
+		}
+
+		if (len == 0)
+			return;
+
+		/* There's no point in using more than 1 nt store for 1 cache line. */
+		if (util_macro::is_2pow(len)) {
+			if (len == 32)
+				memmove_movnt1x32b_avx512f(dest, src);
+			else if (len == 16)
+				memmove_movnt1x16b_avx512f(dest, src);
+			else if (len == 8)
+				memmove_movnt1x8b_avx512f(dest, src);
+			else if (len == 4)
+				memmove_movnt1x4b_avx512f(dest, src);
+			else
+				goto nonnt;
+
+			return;
+		}
+
+		nonnt:
+			memmove_small_flush(dest, src, len);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void
+	memmove_movnt_avx512f_bw(uint8_t *dest, const uint8_t *src, size_t len) {
+		dest += len;
+		src += len;
+
+		size_t cnt = (uint64_t)dest & 63;
+		if (cnt > 0) {
+			if (cnt > len)
+				cnt = len;
+
+			dest -= cnt;
+			src -= cnt;
+			len -= cnt;
+
+			memmove_small_flush(dest, src, cnt);
+		}
+
+		const uint8_t *srcbegin = src - len;
+		prefetch_ini_bw(src, len);
+
+		while (len >= PERF_BARRIER_SIZE) {
+			prefetch_next_bw(src, srcbegin);
+
+			dest -= 4 * 64;
+			src -= 4 * 64;
+			len -= 4 * 64;
+			memmove_movnt4x64b_avx512f(dest, src);
+
+			dest -= 4 * 64;
+			src -= 4 * 64;
+			len -= 4 * 64;
+			memmove_movnt4x64b_avx512f(dest, src);
+
+			dest -= 4 * 64;
+			src -= 4 * 64;
+			len -= 4 * 64;
+			memmove_movnt4x64b_avx512f(dest, src);
+
+			static_assert(PERF_BARRIER_SIZE == (4 + 4 + 4) * 64);
+		}
+
+		while (len >= 4 * 64) {
+			dest -= 4 * 64;
+			src -= 4 * 64;
+			len -= 4 * 64;
+			memmove_movnt4x64b_avx512f(dest, src);
+		}
+
+		if (len >= 2 * 64) {
+			dest -= 2 * 64;
+			src -= 2 * 64;
+			len -= 2 * 64;
+			memmove_movnt2x64b_avx512f(dest, src);
+		}
+
+		if (len >= 1 * 64) {
+			dest -= 1 * 64;
+			src -= 1 * 64;
+			len -= 1 * 64;
+			memmove_movnt1x64b_avx512f(dest, src);
+		}
+
+		if (len == 0)
+			return;
+
+		/* There's no point in using more than 1 nt store for 1 cache line. */
+		if (util_macro::is_2pow(len)) {
+			if (len == 32) {
+				dest -= 32;
+				src -= 32;
+				memmove_movnt1x32b_avx512f(dest, src);
+			}
+			else if (len == 16) {
+				dest -= 16;
+				src -= 16;
+				memmove_movnt1x16b_avx512f(dest, src);
+			}
+			else if (len == 8) {
+				dest -= 8;
+				src -= 8;
+				memmove_movnt1x8b_avx512f(dest, src);
+			}
+			else if (len == 4) {
+				dest -= 4;
+				src -= 4;
+				memmove_movnt1x4b_avx512f(dest, src);
+			}
+			else {
+				goto nonnt;
+			}
+
+			return;
+		}
+
+		nonnt:
+			dest -= len;
+			src -= len;
+			memmove_small_flush(dest, src, len);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memmove_movnt_avx512f(uint8_t *dest, const uint8_t *src, size_t len) {
+		if ((uintptr_t)dest - (uintptr_t)src >= len) {
+			memmove_movnt_avx512f_fw(dest, src, len);
+		}
+		else {
+			memmove_movnt_avx512f_bw(dest, src, len);
+		}
+		_mm256_zeroupper();
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memcpy_movnt4x64b_avx512f(uint8_t * __restrict dest, const uint8_t * __restrict src) {
+		__m512i zmm0 = mm512_loadu_si512(src, 0);
+		__m512i zmm1 = mm512_loadu_si512(src, 1);
+		__m512i zmm2 = mm512_loadu_si512(src, 2);
+		__m512i zmm3 = mm512_loadu_si512(src, 3);
+
+		mm512_stream_si512(dest, 0, zmm0);
+		mm512_stream_si512(dest, 1, zmm1);
+		mm512_stream_si512(dest, 2, zmm2);
+		mm512_stream_si512(dest, 3, zmm3);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memcpy_movnt2x64b_avx512f(uint8_t * __restrict dest, const uint8_t * __restrict src) {
+		__m512i zmm0 = mm512_loadu_si512(src, 0);
+		__m512i zmm1 = mm512_loadu_si512(src, 1);
+
+		mm512_stream_si512(dest, 0, zmm0);
+		mm512_stream_si512(dest, 1, zmm1);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memcpy_movnt1x64b_avx512f(uint8_t * __restrict dest, const uint8_t * __restrict src) {
+		__m512i zmm0 = mm512_loadu_si512(src, 0);
+
+		mm512_stream_si512(dest, 0, zmm0);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memcpy_movnt1x32b_avx512f(uint8_t * __restrict dest, const uint8_t * __restrict src) {
+		__m256i ymm0 = mm256_loadu_si256_avx512f(src, 0);
+
+		mm256_stream_si256_avx512f(dest, 0, ymm0);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memcpy_movnt1x16b_avx512f(uint8_t * __restrict dest, const uint8_t * __restrict src) {
+		__m128i xmm0 = _mm_loadu_si128((const __m128i *)src);
+
+		_mm_stream_si128((__m128i *)dest, xmm0);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memcpy_movnt1x8b_avx512f(uint8_t * __restrict dest, const uint8_t * __restrict src) {
+		_mm_stream_si64((long long *)dest, *(long long *)src);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memcpy_movnt1x4b_avx512f(uint8_t * __restrict dest, const uint8_t * __restrict src) {
+		_mm_stream_si32((int *)dest, *(int *)src);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memcpy_movnt_avx512f_fw(uint8_t * __restrict dest, const uint8_t * __restrict src, size_t len) {
+		size_t cnt = (uint64_t)dest & 63;
+		if (cnt > 0) {
+			cnt = 64 - cnt;
+
+			if (cnt > len)
+				cnt = len;
+
+			memcpy_small_flush(dest, src, cnt);
+
+			dest += cnt;
+			src += cnt;
+			len -= cnt;
+		}
+
+		const uint8_t *srcend = src + len;
+		prefetch_ini_fw(src, len);
+
+		while (len >= PERF_BARRIER_SIZE) {
+			prefetch_next_fw(src, srcend);
+
+			memcpy_movnt4x64b_avx512f(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+
+			memcpy_movnt4x64b_avx512f(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+
+			memcpy_movnt4x64b_avx512f(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+
+			static_assert(PERF_BARRIER_SIZE == (4 + 4 + 4) * 64);
+		}
+
+		while (len >= 4 * 64) {
+			memcpy_movnt4x64b_avx512f(dest, src);
+			dest += 4 * 64;
+			src += 4 * 64;
+			len -= 4 * 64;
+		}
+
+		if (len >= 2 * 64) {
+			memcpy_movnt2x64b_avx512f(dest, src);
+			dest += 2 * 64;
+			src += 2 * 64;
+			len -= 2 * 64;
+		}
+
+		if (len >= 1 * 64) {
+			memcpy_movnt1x64b_avx512f(dest, src);
+
+			dest += 1 * 64;
+			src += 1 * 64;
+			len -= 1 * 64;
+		}
+
+		if (len == 0)
+			return;
+
+		/* There's no point in using more than 1 nt store for 1 cache line. */
+		if (util_macro::is_2pow(len)) {
+			if (len == 32)
+				memcpy_movnt1x32b_avx512f(dest, src);
+			else if (len == 16)
+				memcpy_movnt1x16b_avx512f(dest, src);
+			else if (len == 8)
+				memcpy_movnt1x8b_avx512f(dest, src);
+			else if (len == 4)
+				memcpy_movnt1x4b_avx512f(dest, src);
+			else
+				goto nonnt;
+
+			return;
+		}
+
+		nonnt:
+		memcpy_small_flush(dest, src, len);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memcpy_movnt_avx512f(uint8_t * __restrict dest, const uint8_t * __restrict src, size_t len) {
+		memcpy_movnt_avx512f_fw(dest, src, len);
+		_mm256_zeroupper();
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memset_movnt4x64b_avx512f(uint8_t *dest, __m512i zmm) {
+		mm512_stream_si512(dest, 0, zmm);
+		mm512_stream_si512(dest, 1, zmm);
+		mm512_stream_si512(dest, 2, zmm);
+		mm512_stream_si512(dest, 3, zmm);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memset_movnt2x64b_avx512f(uint8_t *dest, __m512i zmm) {
+		mm512_stream_si512(dest, 0, zmm);
+		mm512_stream_si512(dest, 1, zmm);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memset_movnt1x64b_avx512f(uint8_t *dest, __m512i zmm) {
+		mm512_stream_si512(dest, 0, zmm);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memset_movnt1x32b_avx512f(uint8_t *dest, __m256i ymm) {
+		mm256_stream_si256_avx512f(dest, 0, ymm);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memset_movnt1x16b_avx512f(uint8_t *dest, __m128i xmm) {
+		_mm_stream_si128((__m128i *)dest, xmm);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memset_movnt1x8b_avx512f(uint8_t *dest, __m128i xmm) {
+		_mm_stream_si64((long long *)dest, _mm_cvtsi128_si64(xmm));
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memset_movnt1x4b_avx512f(uint8_t *dest, __m128i xmm) {
+		_mm_stream_si32((int *)dest, _mm_cvtsi128_si32(xmm));
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memset_movnt_avx512f_fw(uint8_t *dest, int c, size_t len) {
+		__m512i zmm = _mm512_set1_epi8((char)c);
+		__m256i ymm = _mm256_set1_epi8((char)c);
+		__m128i xmm = _mm_set1_epi8((char)c);
+
+		size_t cnt = (uint64_t)dest & 63;
+		if (cnt > 0) {
+			cnt = 64 - cnt;
+
+			if (cnt > len)
+				cnt = len;
+
+			memset_small_flush(dest, c, cnt);
+
+			dest += cnt;
+			len -= cnt;
+		}
+
+		while (len >= PERF_BARRIER_SIZE) {
+			memset_movnt4x64b_avx512f(dest, zmm);
+			dest += 4 * 64;
+			len -= 4 * 64;
+
+			memset_movnt4x64b_avx512f(dest, zmm);
+			dest += 4 * 64;
+			len -= 4 * 64;
+
+			memset_movnt4x64b_avx512f(dest, zmm);
+			dest += 4 * 64;
+			len -= 4 * 64;
+
+			static_assert(PERF_BARRIER_SIZE == (4 + 4 + 4) * 64);
+		}
+
+		while (len >= 4 * 64) {
+			memset_movnt4x64b_avx512f(dest, zmm);
+			dest += 4 * 64;
+			len -= 4 * 64;
+		}
+
+		if (len >= 2 * 64) {
+			memset_movnt2x64b_avx512f(dest, zmm);
+			dest += 2 * 64;
+			len -= 2 * 64;
+		}
+
+		if (len >= 1 * 64) {
+			memset_movnt1x64b_avx512f(dest, zmm);
+			dest += 1 * 64;
+			len -= 1 * 64;
+		}
+
+		if (len == 0)
+			return;
+
+		/* There's no point in using more than 1 nt store for 1 cache line. */
+		if (util_macro::is_2pow(len)) {
+			if (len == 32)
+				memset_movnt1x32b_avx512f(dest, ymm);
+			else if (len == 16)
+				memset_movnt1x16b_avx512f(dest, xmm);
+			else if (len == 8)
+				memset_movnt1x8b_avx512f(dest, xmm);
+			else if (len == 4)
+				memset_movnt1x4b_avx512f(dest, xmm);
+			else
+				goto nonnt;
+
+			return;
+		}
+
+		nonnt:
+		memset_small_flush(dest, c, len);
+	}
+
+	__attribute__((target("avx512f")))
+	static inline void memset_movnt_avx512f(uint8_t *dest, int c, size_t len) {
+		memset_movnt_avx512f_fw(dest, c, len);
+		_mm256_zeroupper();
+	}
+}
+
+#endif //UTIL_MEM_NTSTORE_AVX512F_H
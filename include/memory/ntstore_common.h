@@ -0,0 +1,59 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/6/27
+ */
+
+#pragma once
+#ifndef UTIL_MEM_NTSTORE_COMMON_H
+#define UTIL_MEM_NTSTORE_COMMON_H
+
+#include <cstdint>
+#include <cstring>
+
+#include <memory/cache_config.h>
+#include <memory/flush.h>
+#include <memory/nvm_config.h>
+
+/*
+ * Helpers shared by non-temporal kernels of all instruction sets.
+ *
+ * Kernels are organized as a pipeline: the misaligned head (bytes before the first
+ * aligned cache line of destination) and the tail (bytes after the last whole cache line)
+ * are written by cached stores and flushed, while the aligned body is streamed.
+ * Only lines touched by the head and tail are flushed, and always by NVMRuntime, i.e. the flush
+ * instruction chosen at runtime, since kernels are dispatched by plain function pointers which
+ * carry no NVM policy. Callers templated on another policy (e.g. NVMSimulated or NVMConfig<Flush::NONE>) should
+ * either pass only whole aligned cache lines, for which no line is flushed here, or report the
+ * whole range by observe_nt_store<NVMType>() after the kernel, as persist_memcpy() and the redo
+ * log do.
+ */
+
+namespace util_mem {
+
+	/*!
+	 * @brief Move bytes, which are part of at most one cache line in general, by cached stores and flush them.
+	 */
+	static inline void memmove_small_flush(uint8_t *dest, const uint8_t *src, size_t len) {
+		std::memmove(dest, src, len);
+		NVMRuntime::pwb_range(dest, len);
+	}
+
+	/*!
+	 * @brief Copy bytes, which are part of at most one cache line in general, by cached stores and flush them.
+	 */
+	static inline void memcpy_small_flush(uint8_t * __restrict dest, const uint8_t * __restrict src, size_t len) {
+		std::memcpy(dest, src, len);
+		NVMRuntime::pwb_range(dest, len);
+	}
+
+	/*!
+	 * @brief Fill bytes, which are part of at most one cache line in general, by cached stores and flush them.
+	 */
+	static inline void memset_small_flush(uint8_t *dest, int c, size_t len) {
+		std::memset(dest, c, len);
+		NVMRuntime::pwb_range(dest, len);
+	}
+
+}
+
+#endif //UTIL_MEM_NTSTORE_COMMON_H
@@ -0,0 +1,126 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/13
+ */
+
+#pragma once
+#ifndef UTIL_MEM_NTSTORE_CRC32C_H
+#define UTIL_MEM_NTSTORE_CRC32C_H
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <immintrin.h>
+
+#include <arch/cpu_feature.h>
+#include <util/crc32c.h>
+#include <memory/cache_config.h>
+#include <memory/persist_stats.h>
+#include <memory/ntstore.h>
+
+/*
+ * Non-temporal copy fused with CRC32C, which reads each cache line of source once:
+ * the line is loaded for the streaming store and checksummed while it is still in L1.
+ * Lines are taken from 3 blocks in turn, so that the checksum has 3 independent streams
+ * as util::crc32c() does for large buffers.
+ */
+
+namespace util_mem {
+
+	/*!
+	 * @brief Copy one line by non-temporal stores and update the CRC state with it
+	 */
+	__attribute__((target("sse4.2")))
+	static inline uint64_t memcpy_movnt1x64b_crc32c(uint8_t *dest, const uint8_t *src, uint64_t state) {
+		__m128i xmm0 = mm_loadu_si128(src, 0);
+		__m128i xmm1 = mm_loadu_si128(src, 1);
+		__m128i xmm2 = mm_loadu_si128(src, 2);
+		__m128i xmm3 = mm_loadu_si128(src, 3);
+
+		mm_stream_si128(dest, 0, xmm0);
+		mm_stream_si128(dest, 1, xmm1);
+		mm_stream_si128(dest, 2, xmm2);
+		mm_stream_si128(dest, 3, xmm3);
+
+		for (size_t i = 0; i < CACHE_LINE_SIZE; i += sizeof(uint64_t)) {
+			uint64_t word;
+			std::memcpy(&word, src + i, sizeof(uint64_t));
+			state = _mm_crc32_u64(state, word);
+		}
+		return state;
+	}
+
+	__attribute__((target("sse4.2,pclmul")))
+	static inline uint32_t memcpy_movnt_crc32c_interleave(uint8_t *&dest, const uint8_t *&src, size_t &len, uint32_t state,
+	                                                      size_t block, uint32_t shift_1, uint32_t shift_2) {
+		while (len >= 3 * block) {
+			uint64_t state0 = state, state1 = 0, state2 = 0;
+			for (size_t i = 0; i < block; i += CACHE_LINE_SIZE) {
+				state0 = memcpy_movnt1x64b_crc32c(dest + i, src + i, state0);
+				state1 = memcpy_movnt1x64b_crc32c(dest + block + i, src + block + i, state1);
+				state2 = memcpy_movnt1x64b_crc32c(dest + 2 * block + i, src + 2 * block + i, state2);
+			}
+			state = util::crc32c_detail::shift_clmul(static_cast<uint32_t>(state0), shift_2) ^
+			        util::crc32c_detail::shift_clmul(static_cast<uint32_t>(state1), shift_1) ^ static_cast<uint32_t>(state2);
+			dest += 3 * block;
+			src  += 3 * block;
+			len  -= 3 * block;
+		}
+		return state;
+	}
+
+	__attribute__((target("sse4.2,pclmul")))
+	static inline uint32_t memcpy_movnt_crc32c_sse42(uint8_t *dest, const uint8_t *src, size_t len, uint32_t crc) {
+		using namespace util::crc32c_detail;
+
+		// The unaligned head and tail are small, which are copied by the common kernel and checksummed separately.
+		size_t head_len = std::min(len, (CACHE_LINE_SIZE - reinterpret_cast<uintptr_t>(dest) % CACHE_LINE_SIZE) % CACHE_LINE_SIZE);
+		if (head_len > 0) {
+			memcpy_movnt(dest, src, head_len);
+			crc   = util::crc32c_hw(src, head_len, crc);
+			dest += head_len;
+			src  += head_len;
+			len  -= head_len;
+		}
+
+		size_t body_len = len - len % CACHE_LINE_SIZE;
+		size_t tail_len = len - body_len;
+		uint32_t state  = ~crc;
+		state = memcpy_movnt_crc32c_interleave(dest, src, body_len, state, LONG_BLOCK, LONG_SHIFT_1, LONG_SHIFT_2);
+		state = memcpy_movnt_crc32c_interleave(dest, src, body_len, state, SHORT_BLOCK, SHORT_SHIFT_1, SHORT_SHIFT_2);
+		uint64_t state64 = state;
+		for (; body_len > 0; body_len -= CACHE_LINE_SIZE, dest += CACHE_LINE_SIZE, src += CACHE_LINE_SIZE) {
+			state64 = memcpy_movnt1x64b_crc32c(dest, src, state64);
+		}
+		persist_stat_add_nt_bytes(len - tail_len);
+		crc = ~static_cast<uint32_t>(state64);
+
+		if (tail_len > 0) {
+			memcpy_movnt(dest, src, tail_len);
+			crc = util::crc32c_hw(src, tail_len, crc);
+		}
+		return crc;
+	}
+
+	/*!
+	 * @brief Copy by non-temporal stores and compute CRC32C of the data.
+	 * Like memcpy_movnt(), the stores should be drained by sfence, and the misaligned head and tail are
+	 * flushed by NVMRuntime.
+	 * @param dest The destination
+	 * @param src The source data
+	 * @param len The length of data
+	 * @param crc CRC of preceding data, see util::crc32c()
+	 * @return CRC of the data
+	 */
+	static inline uint32_t memcpy_movnt_crc32c(uint8_t * __restrict dest, const uint8_t * __restrict src, size_t len, uint32_t crc = 0) {
+		static const bool use_hw = get_cpu_feature().sse4_2 && get_cpu_feature().pclmul;
+		if (use_hw) {
+			return memcpy_movnt_crc32c_sse42(dest, src, len, crc);
+		}
+		memcpy_movnt(dest, src, len);
+		return util::crc32c_sw(src, len, crc);
+	}
+
+}
+
+#endif //UTIL_MEM_NTSTORE_CRC32C_H
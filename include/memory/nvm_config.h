@@ -7,7 +7,10 @@
 #ifndef UTIL_MEM_NVM_CONFIG_H
 #define UTIL_MEM_NVM_CONFIG_H
 
+#include <atomic>
+
 #include <memory/flush.h>
+#include <memory/flush_detect.h>
 
 inline namespace util_mem {
 
@@ -24,6 +27,7 @@ inline namespace util_mem {
 
 		static inline void fence() {
 			std::atomic_thread_fence(std::memory_order::acq_rel);
+			persist_stat_add_fence();
 		}
 	};
 
@@ -40,6 +44,7 @@ inline namespace util_mem {
 
 		static inline void fence() {
 			asm volatile("sfence\n" : :);
+			persist_stat_add_fence();
 		}
 	};
 
@@ -71,9 +76,104 @@ inline namespace util_mem {
 
 		static inline void fence() {
 			asm volatile("sfence\n" : :);
+			persist_stat_add_fence();
+		}
+	};
+
+	/*!
+	 * @brief Flush-free policy for platforms with eADR, where data reaching cpu caches is persistent.
+	 * Fence is still necessary to order stores and drain non-temporal stores.
+	 */
+	template<>
+	struct NVMConfig<Flush::NONE> {
+
+		static inline void pwb([[maybe_unused]] void *target) {
+		}
+
+		static inline void pwb_range([[maybe_unused]] void *start_ptr, [[maybe_unused]] uint32_t size) {
+		}
+
+		static inline void fence() {
+			asm volatile("sfence\n" : :);
+			persist_stat_add_fence();
+		}
+	};
+
+	/*!
+	 * @brief Flush policy decided at runtime by the features of platform (see detect_pwb_type()).
+	 * Each call of pwb/pwb_range/fence dispatches once by a well-predicted branch.
+	 * Hot paths templated on the flush policy should call dispatch() to choose the policy
+	 * once per call-site rather than once per cache line.
+	 * For example:
+	 *	NVMRuntime::dispatch([&]<class NVMType>() { persist_memcpy<NVMType>(dest, src, len); });
+	 */
+	template<>
+	struct NVMConfig<Flush::RUNTIME> {
+
+		static inline Flush get_pwb_type() {
+			return get_runtime_pwb_type();
 		}
+
+		template<class Func>
+		static inline decltype(auto) dispatch(Func &&func) {
+			switch (get_runtime_pwb_type()) {
+				case Flush::CLFLUSHOPT:
+					return func.template operator()<NVMConfig<Flush::CLFLUSHOPT>>();
+				case Flush::CLFLUSH:
+					return func.template operator()<NVMConfig<Flush::CLFLUSH>>();
+				case Flush::NONE:
+					return func.template operator()<NVMConfig<Flush::NONE>>();
+				default:
+					return func.template operator()<NVMConfig<Flush::CLWB>>();
+			}
+		}
+
+		static inline void pwb(void *target) {
+			dispatch([target]<class NVMType>() { NVMType::pwb(target); });
+		}
+
+		static inline void pwb_range(void *start_ptr, uint32_t size) {
+			dispatch([start_ptr, size]<class NVMType>() { NVMType::pwb_range(start_ptr, size); });
+		}
+
+		static inline void fence() {
+			dispatch([]<class NVMType>() { NVMType::fence(); });
+		}
+	};
+
+	using NVMRuntime = NVMConfig<Flush::RUNTIME>;
+
+	/*!
+	 * @brief Policies observing non-temporal stores and their drain (e.g. the simulator),
+	 * which bypass pwb() and fence() of the policy.
+	 */
+	template<class NVMType>
+	concept NTStoreObserver = requires(void *ptr, size_t size) {
+		NVMType::observe_nt_store(ptr, size);
+		NVMType::observe_nt_drain();
 	};
 
+	/*!
+	 * @brief Notify the policy of a non-temporal store. Nothing is done for real policies.
+	 */
+	template<class NVMType>
+	inline void observe_nt_store([[maybe_unused]] void *ptr, [[maybe_unused]] size_t size) {
+		if constexpr (NTStoreObserver<NVMType>) {
+			NVMType::observe_nt_store(ptr, size);
+		}
+	}
+
+	/*!
+	 * @brief Drain non-temporal stores of the current thread, which needs sfence whatever the flush type is.
+	 */
+	template<class NVMType>
+	inline void drain_nt_store() {
+		sfence();
+		if constexpr (NTStoreObserver<NVMType>) {
+			NVMType::observe_nt_drain();
+		}
+	}
+
 	using NVM = NVMConfig<PWB_ENUM>;
 }
 
@@ -0,0 +1,413 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/6/30
+ */
+
+#pragma once
+#ifndef UTIL_MEM_NVM_SIMULATOR_H
+#define UTIL_MEM_NVM_SIMULATOR_H
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+
+#include <util/utility_macro.h>
+#include <memory/cache_config.h>
+#include <memory/flush.h>
+#include <memory/nvm_config.h>
+#include <memory/file_descriptor.h>
+
+/*
+ * A software model of persistence for testing the placement of pwb and fence, which runs without NVM.
+ *
+ * The simulator shadows attached regions with the image which is guaranteed to survive a crash.
+ * Several regions can be attached (e.g. a log and the data it protects), whose images are concatenated.
+ * Stores are not intercepted: the content of a line at the time of pwb() is recorded as pending
+ * for the issuing thread, and becomes persistent only after the same thread calls fence()
+ * (sfence only takes effect on the issuing core). Non-temporal stores are treated in the same way.
+ *
+ * At any point (with no concurrent writer), each line of region is in one of following states:
+ *  PERSISTED: The current content has been persisted.
+ *  FLUSHED:   The current content has been flushed by the latest flush of line, but not fenced yet.
+ *  DIRTY:     The current content has not been flushed.
+ * After a crash, a line may hold the persisted content, any pending flushed content (including earlier
+ * flushes of a line flushed several times), or the current content (as caches may write back dirty
+ * lines at any time). The simulator can enumerate all
+ * these legal images, with the granularity of cache line, and load one of them into the regions
+ * to run recovery on it.
+ */
+
+inline namespace util_mem {
+
+	enum class SimulatedLineState {
+		PERSISTED,
+		FLUSHED,
+		DIRTY
+	};
+
+	class NVMSimulator {
+	private:
+		using LineData = std::array<uint8_t, CACHE_LINE_SIZE>;
+
+		struct PendingLine {
+			/// The index of line in region
+			size_t line_index;
+			/// The content of line at the time of flush
+			LineData data;
+		};
+
+		/// A line which may have several contents after crash
+		struct UncertainLine {
+			size_t line_index;
+			/// The first candidate is always the persisted content
+			std::vector<LineData> candidate_array;
+		};
+
+		struct Region {
+			uint8_t *start_ptr;
+
+			size_t size;
+			/// The offset of region in image
+			size_t image_offset;
+		};
+
+	private:
+		std::mutex mutex_;
+
+		std::vector<Region> region_array_;
+		/// The content guaranteed to survive a crash, concatenated in order of attachment
+		std::vector<uint8_t> persisted_image_;
+		/// Lines flushed but not fenced, for each thread
+		std::unordered_map<std::thread::id, std::vector<PendingLine>> pending_map_;
+		/// The number of flushes on lines whose content has been persisted or flushed already
+		uint64_t redundant_pwb_count_;
+
+	public:
+		NVMSimulator(): redundant_pwb_count_(0) {}
+
+		NVMSimulator(const NVMSimulator &other) = delete;
+
+		~NVMSimulator() = default;
+
+	public:
+		/*!
+		 * @brief Shadow a region in addition to attached ones, whose current content is regarded as persistent.
+		 * @param start_ptr The start of region, aligned to cache line
+		 * @param size The size of region, aligned to cache line
+		 */
+		void attach(void *start_ptr, size_t size) {
+			assert(reinterpret_cast<uintptr_t>(start_ptr) % CACHE_LINE_SIZE == 0);
+			assert(size % CACHE_LINE_SIZE == 0);
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto *byte_ptr = static_cast<uint8_t *>(start_ptr);
+			region_array_.push_back({ byte_ptr, size, persisted_image_.size() });
+			persisted_image_.insert(persisted_image_.end(), byte_ptr, byte_ptr + size);
+		}
+
+		/*!
+		 * @brief Shadow the aligned mapped area of file
+		 */
+		void attach(FileDescriptor &file_descriptor) {
+			attach(file_descriptor.aligned_start_ptr,
+			       util_macro::floor_2pow(file_descriptor.aligned_total_size, CACHE_LINE_SIZE));
+		}
+
+		/*!
+		 * @brief Stop shadowing all regions
+		 */
+		void detach() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			region_array_.clear();
+			persisted_image_.clear();
+			pending_map_.clear();
+			redundant_pwb_count_ = 0;
+		}
+
+		/*!
+		 * @brief Record the flush of the line containing target. Addresses out of regions are ignored.
+		 */
+		void pwb(const void *target) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			size_t line_index;
+			if (!find_line(target, line_index)) { return; }
+
+			const uint8_t *line = get_line_ptr(line_index);
+			auto &pending_array = pending_map_[std::this_thread::get_id()];
+
+			// Earlier flushes of the line are kept, as any of them may have reached NVM before a crash
+			const PendingLine *latest = find_latest_pending(pending_array, line_index);
+			const uint8_t *latest_data = latest != nullptr ? latest->data.data() : persisted_image_.data() + line_index * CACHE_LINE_SIZE;
+			if (std::memcmp(line, latest_data, CACHE_LINE_SIZE) == 0) {
+				++redundant_pwb_count_;
+				return;
+			}
+
+			PendingLine &pending = pending_array.emplace_back();
+			pending.line_index   = line_index;
+			std::memcpy(pending.data.data(), line, CACHE_LINE_SIZE);
+		}
+
+		/*!
+		 * @brief Record the flush of all lines overlapped by [start_ptr, start_ptr + size)
+		 */
+		void pwb_range(const void *start_ptr, size_t size) {
+			uintptr_t line = cache_line_floor(start_ptr);
+			uintptr_t end  = reinterpret_cast<uintptr_t>(start_ptr) + size;
+			for (; line < end; line += CACHE_LINE_SIZE) {
+				pwb(reinterpret_cast<const void *>(line));
+			}
+		}
+
+		/*!
+		 * @brief Persist lines flushed by the current thread, with the latest flush of each line
+		 */
+		void fence() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto iter = pending_map_.find(std::this_thread::get_id());
+			if (iter == pending_map_.end()) { return; }
+
+			for (auto &pending: iter->second) {
+				std::memcpy(persisted_image_.data() + pending.line_index * CACHE_LINE_SIZE, pending.data.data(), CACHE_LINE_SIZE);
+			}
+			iter->second.clear();
+		}
+
+		[[nodiscard]] SimulatedLineState get_line_state(const void *target) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			size_t line_index = 0;
+			[[maybe_unused]] bool found = find_line(target, line_index);
+			assert(found);
+			return get_line_state_unlocked(line_index);
+		}
+
+		/*!
+		 * @brief Get addresses of lines which are not persisted (FLUSHED or DIRTY)
+		 */
+		[[nodiscard]] std::vector<void *> get_unpersisted_lines() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			std::vector<void *> res;
+			for (size_t line_index = 0; line_index < get_num_line(); ++line_index) {
+				if (get_line_state_unlocked(line_index) != SimulatedLineState::PERSISTED) {
+					res.emplace_back(get_line_ptr(line_index));
+				}
+			}
+			return res;
+		}
+
+		[[nodiscard]] uint64_t get_redundant_pwb_count() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			return redundant_pwb_count_;
+		}
+
+		/*!
+		 * @brief Count legal images after crash at this point, saturated at the max of uint64_t.
+		 */
+		[[nodiscard]] uint64_t count_crash_images() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			uint64_t res = 1;
+			for (auto &uncertain: collect_uncertain_lines()) {
+				uint64_t num_candidate = uncertain.candidate_array.size();
+				if (res > std::numeric_limits<uint64_t>::max() / num_candidate) {
+					return std::numeric_limits<uint64_t>::max();
+				}
+				res *= num_candidate;
+			}
+			return res;
+		}
+
+		/*!
+		 * @brief Enumerate legal images after crash at this point.
+		 * The first image is the persisted one. Images are generated incrementally in one buffer,
+		 * so that only changed lines are rewritten between two images.
+		 * @param func Called as func(const uint8_t *image, size_t size) for each image
+		 * @param max_image The max number of images to enumerate
+		 * @return The number of enumerated images
+		 */
+		template<class Func>
+		uint64_t for_each_crash_image(Func &&func, uint64_t max_image = std::numeric_limits<uint64_t>::max()) {
+			std::vector<uint8_t> image;
+			std::vector<UncertainLine> uncertain_array;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				image           = persisted_image_;
+				uncertain_array = collect_uncertain_lines();
+			}
+
+			// Odometer over candidates of all uncertain lines
+			std::vector<size_t> choice_array(uncertain_array.size(), 0);
+			uint64_t num_image = 0;
+			while (num_image < max_image) {
+				func(static_cast<const uint8_t *>(image.data()), image.size());
+				++num_image;
+
+				size_t pos = 0;
+				for (; pos < uncertain_array.size(); ++pos) {
+					auto &uncertain = uncertain_array[pos];
+					choice_array[pos] = (choice_array[pos] + 1) % uncertain.candidate_array.size();
+					std::memcpy(image.data() + uncertain.line_index * CACHE_LINE_SIZE,
+					            uncertain.candidate_array[choice_array[pos]].data(), CACHE_LINE_SIZE);
+					if (choice_array[pos] != 0) { break; }
+				}
+				if (pos == uncertain_array.size()) { break; }
+			}
+			return num_image;
+		}
+
+		/*!
+		 * @brief Crash with the given image: copy it into regions as their persisted content,
+		 * and drop pending flushes, so that recovery can run on it (still under simulation).
+		 * @param image An image given by for_each_crash_image()
+		 */
+		void load_image(const uint8_t *image) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (auto &region: region_array_) {
+				std::memcpy(region.start_ptr, image + region.image_offset, region.size);
+			}
+			persisted_image_.assign(image, image + persisted_image_.size());
+			pending_map_.clear();
+		}
+
+	private:
+		/*!
+		 * @brief Get the latest flush of line in the pending flushes of a thread, which is persisted by fence
+		 */
+		[[nodiscard]] static const PendingLine *find_latest_pending(const std::vector<PendingLine> &pending_array, size_t line_index) {
+			for (auto iter = pending_array.rbegin(); iter != pending_array.rend(); ++iter) {
+				if (iter->line_index == line_index) {
+					return &*iter;
+				}
+			}
+			return nullptr;
+		}
+
+		[[nodiscard]] size_t get_num_line() const {
+			return persisted_image_.size() / CACHE_LINE_SIZE;
+		}
+
+		/*!
+		 * @brief Get the index of line in image
+		 */
+		[[nodiscard]] bool find_line(const void *target, size_t &line_index) const {
+			auto *ptr = static_cast<const uint8_t *>(target);
+			for (auto &region: region_array_) {
+				if (ptr >= region.start_ptr && ptr < region.start_ptr + region.size) {
+					line_index = (region.image_offset + (cache_line_floor(target) - reinterpret_cast<uintptr_t>(region.start_ptr))) / CACHE_LINE_SIZE;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		[[nodiscard]] uint8_t *get_line_ptr(size_t line_index) const {
+			size_t image_offset = line_index * CACHE_LINE_SIZE;
+			for (auto &region: region_array_) {
+				if (image_offset < region.image_offset + region.size) {
+					return region.start_ptr + (image_offset - region.image_offset);
+				}
+			}
+			assert(false && "Line out of regions");
+			return nullptr;
+		}
+
+		[[nodiscard]] SimulatedLineState get_line_state_unlocked(size_t line_index) const {
+			const uint8_t *line = get_line_ptr(line_index);
+			if (std::memcmp(line, persisted_image_.data() + line_index * CACHE_LINE_SIZE, CACHE_LINE_SIZE) == 0) {
+				return SimulatedLineState::PERSISTED;
+			}
+			for (auto &[thread_id, pending_array]: pending_map_) {
+				const PendingLine *latest = find_latest_pending(pending_array, line_index);
+				if (latest != nullptr && std::memcmp(latest->data.data(), line, CACHE_LINE_SIZE) == 0) {
+					return SimulatedLineState::FLUSHED;
+				}
+			}
+			return SimulatedLineState::DIRTY;
+		}
+
+		/*!
+		 * @brief Collect lines with more than one distinct candidate after crash
+		 */
+		[[nodiscard]] std::vector<UncertainLine> collect_uncertain_lines() const {
+			std::unordered_map<size_t, std::vector<LineData>> candidate_map;
+
+			auto add_candidate = [&](size_t line_index, const uint8_t *data) {
+				const uint8_t *persisted = persisted_image_.data() + line_index * CACHE_LINE_SIZE;
+				if (std::memcmp(data, persisted, CACHE_LINE_SIZE) == 0) { return; }
+
+				auto &candidate_array = candidate_map[line_index];
+				if (candidate_array.empty()) {
+					std::memcpy(candidate_array.emplace_back().data(), persisted, CACHE_LINE_SIZE);
+				}
+				for (auto &candidate: candidate_array) {
+					if (std::memcmp(candidate.data(), data, CACHE_LINE_SIZE) == 0) { return; }
+				}
+				std::memcpy(candidate_array.emplace_back().data(), data, CACHE_LINE_SIZE);
+			};
+
+			for (auto &[thread_id, pending_array]: pending_map_) {
+				for (auto &pending: pending_array) {
+					add_candidate(pending.line_index, pending.data.data());
+				}
+			}
+			for (auto &region: region_array_) {
+				size_t first_line = region.image_offset / CACHE_LINE_SIZE;
+				for (size_t i = 0; i < region.size / CACHE_LINE_SIZE; ++i) {
+					add_candidate(first_line + i, region.start_ptr + i * CACHE_LINE_SIZE);
+				}
+			}
+
+			std::vector<UncertainLine> res;
+			res.reserve(candidate_map.size());
+			for (auto &[line_index, candidate_array]: candidate_map) {
+				res.push_back({ line_index, std::move(candidate_array) });
+			}
+			std::sort(res.begin(), res.end(), [](const UncertainLine &a, const UncertainLine &b) {
+				return a.line_index < b.line_index;
+			});
+			return res;
+		}
+	};
+
+	inline NVMSimulator NVM_SIMULATOR;
+
+	/*!
+	 * @brief Debug policy recording flushes and fences in NVM_SIMULATOR instead of issuing them.
+	 * Non-temporal stores are observed by persist_memcpy() and the like as flushed lines.
+	 */
+	template<>
+	struct NVMConfig<Flush::SIMULATED> {
+
+		static inline void pwb(void *target) {
+			NVM_SIMULATOR.pwb(target);
+		}
+
+		static inline void pwb_range(void *start_ptr, uint32_t size) {
+			NVM_SIMULATOR.pwb_range(start_ptr, size);
+		}
+
+		static inline void fence() {
+			asm volatile("sfence\n" : :);
+			NVM_SIMULATOR.fence();
+		}
+
+		static inline void observe_nt_store(void *ptr, size_t size) {
+			NVM_SIMULATOR.pwb_range(ptr, size);
+		}
+
+		static inline void observe_nt_drain() {
+			NVM_SIMULATOR.fence();
+		}
+	};
+
+	using NVMSimulated = NVMConfig<Flush::SIMULATED>;
+
+}
+
+#endif //UTIL_MEM_NVM_SIMULATOR_H
@@ -0,0 +1,79 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/6/26
+ */
+
+#pragma once
+#ifndef UTIL_MEM_PARALLEL_COPY_H
+#define UTIL_MEM_PARALLEL_COPY_H
+
+#include <cstdint>
+#include <algorithm>
+
+#include <thread/thread_numa.h>
+#include <thread/thread_worker.h>
+#include <memory/memory_config.h>
+#include <memory/nvm_config.h>
+#include <memory/persist.h>
+
+inline namespace util_mem {
+
+	/// The granularity of stripes assigned to workers
+	constexpr size_t PARALLEL_COPY_STRIPE_SIZE = 4_KB;
+
+	/// Copy smaller than this is not worth waking up workers
+	#ifndef PARALLEL_COPY_MIN_SIZE_DEFINED
+		constexpr size_t PARALLEL_COPY_MIN_SIZE = 1_MB;
+	#else
+		constexpr size_t PARALLEL_COPY_MIN_SIZE = PARALLEL_COPY_MIN_SIZE_DEFINED;
+	#endif
+
+	/*!
+	 * @brief Copy a large region to NVM with several workers and make it persistent.
+	 * The destination is split into contiguous parts whose boundaries are aligned to 4 KiB stripes.
+	 * Workers run on the numa node owning the destination, each of which streams its part
+	 * by non-temporal stores and drains its own write-combining buffers once at the end
+	 * (sfence only takes effect on the issuing core). All data is persistent when this function returns.
+	 * @tparam NVMType The configuration of flush and fence
+	 * @param dest The destination on NVM
+	 * @param src The source data
+	 * @param len The length of data
+	 * @param num_thread The number of workers
+	 */
+	template<class NVMType = NVM>
+	inline void parallel_persist_copy(void *dest, const void *src, size_t len, int num_thread) {
+		uint8_t *dest_ptr      = static_cast<uint8_t *>(dest);
+		const uint8_t *src_ptr = static_cast<const uint8_t *>(src);
+
+		size_t num_stripe = len / PARALLEL_COPY_STRIPE_SIZE;
+		if (num_thread <= 1 || len < PARALLEL_COPY_MIN_SIZE || num_stripe < static_cast<size_t>(num_thread)) {
+			persist_memcpy<NVMType>(dest_ptr, src_ptr, len, PersistFlag::NON_TEMPORAL);
+			return;
+		}
+
+		// Boundaries of parts are aligned to stripes in the address space of destination
+		uintptr_t dest_begin = reinterpret_cast<uintptr_t>(dest_ptr);
+		uintptr_t dest_end   = dest_begin + len;
+		size_t stripe_per_thread = num_stripe / num_thread;
+
+		auto get_boundary = [&](int worker_id) -> uintptr_t {
+			if (worker_id == 0) { return dest_begin; }
+			if (worker_id == num_thread) { return dest_end; }
+			uintptr_t boundary = dest_begin + worker_id * stripe_per_thread * PARALLEL_COPY_STRIPE_SIZE;
+			return util_macro::floor_2pow(boundary, PARALLEL_COPY_STRIPE_SIZE);
+		};
+
+		int numa_id = thread::NUMAConfig::get_node_of_address(dest_ptr);
+
+		thread::run_workers_on_node(numa_id, num_thread, [&](int worker_id) {
+			uintptr_t part_begin = get_boundary(worker_id);
+			uintptr_t part_end   = get_boundary(worker_id + 1);
+			size_t offset        = part_begin - dest_begin;
+
+			persist_memcpy<NVMType>(dest_ptr + offset, src_ptr + offset, part_end - part_begin, PersistFlag::NON_TEMPORAL);
+		});
+	}
+
+}
+
+#endif //UTIL_MEM_PARALLEL_COPY_H
@@ -0,0 +1,370 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/6/25
+ */
+
+#pragma once
+#ifndef UTIL_MEM_PERSIST_H
+#define UTIL_MEM_PERSIST_H
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <util/enum_operator.h>
+#include <util/atomic128.h>
+#include <memory/cache_config.h>
+#include <memory/flush.h>
+#include <memory/ntstore.h>
+#include <memory/nvm_config.h>
+
+inline namespace util_mem {
+
+	/*!
+	 * @brief Flags to adjust the behaviour of persistent copy
+	 * NO_DRAIN: Skip the final fence, so that the caller can batch fences of several copies.
+	 * NO_FLUSH: Skip the flush of cache lines (data is still copied and drained).
+	 * TEMPORAL: Always use cached stores with flush.
+	 * NON_TEMPORAL: Always use non-temporal stores for the cache-line-aligned body.
+	 */
+	enum class PersistFlag: uint32_t {
+		NONE         = 0,
+		NO_DRAIN     = 1,
+		NO_FLUSH     = 2,
+		TEMPORAL     = 4,
+		NON_TEMPORAL = 8
+	};
+
+}
+
+namespace util {
+
+	template<>
+	struct EnableEnumOperator<util_mem::PersistFlag> {
+		static constexpr bool enable = true;
+	};
+
+}
+
+inline namespace util_mem {
+
+	/// Copy smaller than this is done by cached stores and flush, as non-temporal stores don't pay off.
+	#ifndef PERSIST_MOVNT_THRESHOLD_DEFINED
+		constexpr size_t PERSIST_MOVNT_THRESHOLD = 256;
+	#else
+		constexpr size_t PERSIST_MOVNT_THRESHOLD = PERSIST_MOVNT_THRESHOLD_DEFINED;
+	#endif
+
+	inline constexpr bool has_persist_flag(PersistFlag flags, PersistFlag target) {
+		return (flags & target) != PersistFlag::NONE;
+	}
+
+	namespace persist_detail {
+
+		/*!
+		 * @brief Store data into a range by the given operations and make it persistent.
+		 * The head and tail which don't fill a whole cache line are written by cached stores and flushed,
+		 * while the aligned body is written by non-temporal stores, which needn't any flush.
+		 * At most one fence is issued at the end.
+		 * @param dest The destination on NVM
+		 * @param len The length of data
+		 * @param flags Flags adjusting the behaviour
+		 * @param store Called as store(dest_ptr, offset, size) to write by cached stores
+		 * @param store_nt Called as store_nt(dest_ptr, offset, size) to write whole cache lines by non-temporal stores
+		 */
+		template<class NVMType, class StoreFunc, class StoreNTFunc>
+		inline void persist_range(uint8_t *dest, size_t len, PersistFlag flags, StoreFunc &&store, StoreNTFunc &&store_nt) {
+			bool use_nt = !has_persist_flag(flags, PersistFlag::TEMPORAL) &&
+			              (has_persist_flag(flags, PersistFlag::NON_TEMPORAL) || len >= PERSIST_MOVNT_THRESHOLD);
+
+			if (!use_nt) {
+				store(dest, 0, len);
+				if (!has_persist_flag(flags, PersistFlag::NO_FLUSH)) {
+					NVMType::pwb_range(dest, len);
+				}
+				if (!has_persist_flag(flags, PersistFlag::NO_DRAIN)) {
+					NVMType::fence();
+				}
+				return;
+			}
+
+			// Head: bytes before the first aligned cache line of destination
+			size_t head = (CACHE_LINE_SIZE - (reinterpret_cast<uintptr_t>(dest) & (CACHE_LINE_SIZE - 1))) & (CACHE_LINE_SIZE - 1);
+			if (head > len) {
+				head = len;
+			}
+			if (head > 0) {
+				store(dest, 0, head);
+				if (!has_persist_flag(flags, PersistFlag::NO_FLUSH)) {
+					NVMType::pwb_range(dest, head);
+				}
+			}
+
+			// Body: whole cache lines, streamed to memory directly
+			size_t body = (len - head) & ~(static_cast<size_t>(CACHE_LINE_SIZE) - 1);
+			if (body > 0) {
+				store_nt(dest + head, head, body);
+				observe_nt_store<NVMType>(dest + head, body);
+			}
+
+			// Tail: bytes in the last partial cache line
+			size_t offset = head + body;
+			if (offset < len) {
+				store(dest + offset, offset, len - offset);
+				if (!has_persist_flag(flags, PersistFlag::NO_FLUSH)) {
+					NVMType::pwb_range(dest + offset, len - offset);
+				}
+			}
+
+			// Non-temporal stores are only ordered by sfence, whatever the flush type is.
+			if (!has_persist_flag(flags, PersistFlag::NO_DRAIN)) {
+				drain_nt_store<NVMType>();
+			}
+		}
+
+	}
+
+	/*!
+	 * @brief Copy data and make it persistent.
+	 * The head and tail which don't fill a whole cache line are copied by cached stores and flushed,
+	 * while the aligned body is copied by non-temporal stores, which needn't any flush.
+	 * At most one fence is issued at the end.
+	 * @tparam NVMType The configuration of flush and fence
+	 * @param dest The destination on NVM
+	 * @param src The source data
+	 * @param len The length of data
+	 * @param flags Flags adjusting the behaviour
+	 */
+	template<class NVMType = NVM>
+	inline void persist_memcpy(void *dest, const void *src, size_t len, PersistFlag flags = PersistFlag::NONE) {
+		const uint8_t *src_ptr = static_cast<const uint8_t *>(src);
+		persist_detail::persist_range<NVMType>(static_cast<uint8_t *>(dest), len, flags,
+			[src_ptr](uint8_t *dest_ptr, size_t offset, size_t size) { std::memcpy(dest_ptr, src_ptr + offset, size); },
+			[src_ptr](uint8_t *dest_ptr, size_t offset, size_t size) { memcpy_movnt(dest_ptr, src_ptr + offset, size); });
+	}
+
+	/*!
+	 * @brief Fill memory with a constant byte and make it persistent.
+	 * It works in the same way as persist_memcpy(), which is suitable for zeroing large pools.
+	 * @tparam NVMType The configuration of flush and fence
+	 * @param dest The destination on NVM
+	 * @param c The byte to fill
+	 * @param len The length of data
+	 * @param flags Flags adjusting the behaviour
+	 */
+	template<class NVMType = NVM>
+	inline void persist_memset(void *dest, int c, size_t len, PersistFlag flags = PersistFlag::NONE) {
+		persist_detail::persist_range<NVMType>(static_cast<uint8_t *>(dest), len, flags,
+			[c](uint8_t *dest_ptr, size_t, size_t size) { std::memset(dest_ptr, c, size); },
+			[c](uint8_t *dest_ptr, size_t, size_t size) { memset_movnt(dest_ptr, c, size); });
+	}
+
+	/*!
+	 * @brief Description of one copy in persist_copyv()
+	 */
+	struct persist_iov {
+		/// The destination on NVM
+		void *dest;
+		/// The source data
+		const void *src;
+		/// The length of data
+		size_t len;
+	};
+
+	/// The number of ranges recorded on stack by persist_copyv(), beyond which heap is used.
+	constexpr size_t PERSIST_COPYV_STACK_RANGE = 64;
+
+	/*!
+	 * @brief Copy a batch of (small and disjoint) ranges and make all of them persistent.
+	 * Dirty ranges are sorted and coalesced by cache line, so that each dirty line is
+	 * flushed exactly once, and at most one fence is issued at the end.
+	 * Ranges no smaller than PERSIST_MOVNT_THRESHOLD stream their aligned body,
+	 * leaving only their head and tail to be flushed.
+	 * @tparam NVMType The configuration of flush and fence
+	 * @param iov The array of copies
+	 * @param n The number of copies
+	 * @param flags Only NO_DRAIN is accepted.
+	 */
+	template<class NVMType = NVM>
+	inline void persist_copyv(const persist_iov *iov, size_t n, PersistFlag flags = PersistFlag::NONE) {
+		using Range = std::pair<uintptr_t, uintptr_t>;
+
+		Range stack_range_array[PERSIST_COPYV_STACK_RANGE];
+		std::vector<Range> heap_range_array;
+		Range *range_array = stack_range_array;
+		if (n * 2 > PERSIST_COPYV_STACK_RANGE) {
+			heap_range_array.resize(n * 2);
+			range_array = heap_range_array.data();
+		}
+
+		// Copy data and record dirty ranges
+		size_t num_range = 0;
+		bool use_nt      = false;
+		for (size_t i = 0; i < n; ++i) {
+			uintptr_t begin = reinterpret_cast<uintptr_t>(iov[i].dest);
+			uintptr_t end   = begin + iov[i].len;
+			if (iov[i].len == 0) {
+				continue;
+			}
+
+			if (iov[i].len < PERSIST_MOVNT_THRESHOLD) {
+				std::memcpy(iov[i].dest, iov[i].src, iov[i].len);
+				range_array[num_range++] = { begin, end };
+				continue;
+			}
+
+			persist_memcpy<NVMType>(iov[i].dest, iov[i].src, iov[i].len,
+			                        PersistFlag::NON_TEMPORAL | PersistFlag::NO_FLUSH | PersistFlag::NO_DRAIN);
+			use_nt = true;
+
+			uintptr_t body_begin = util_macro::ceil_2pow(begin, CACHE_LINE_SIZE);
+			uintptr_t body_end   = util_macro::floor_2pow(end, CACHE_LINE_SIZE);
+			if (begin < body_begin) {
+				range_array[num_range++] = { begin, body_begin };
+			}
+			if (body_end < end) {
+				range_array[num_range++] = { body_end, end };
+			}
+		}
+
+		// Coalesce ranges by cache line and flush each line once
+		for (size_t i = 0; i < num_range; ++i) {
+			range_array[i].first  = util_macro::floor_2pow(range_array[i].first, CACHE_LINE_SIZE);
+			range_array[i].second = util_macro::ceil_2pow(range_array[i].second, CACHE_LINE_SIZE);
+		}
+		std::sort(range_array, range_array + num_range);
+
+		uintptr_t flushed_end = 0;
+		for (size_t i = 0; i < num_range; ++i) {
+			uintptr_t line = std::max(range_array[i].first, flushed_end);
+			for (; line < range_array[i].second; line += CACHE_LINE_SIZE) {
+				NVMType::pwb(reinterpret_cast<void *>(line));
+			}
+			flushed_end = std::max(flushed_end, range_array[i].second);
+		}
+
+		if (!has_persist_flag(flags, PersistFlag::NO_DRAIN)) {
+			if (use_nt) {
+				drain_nt_store<NVMType>();
+			}
+			else {
+				NVMType::fence();
+			}
+		}
+	}
+
+
+	/*
+	 * Atomic updates of small metadata (version words, commit markers, pointer swings),
+	 * which are stored, flushed and fenced in this order. The value should never straddle
+	 * cache lines, which is guaranteed by requiring natural alignment of its type.
+	 */
+
+	template<class T>
+	concept PersistAtomicType = std::is_trivially_copyable_v<T> &&
+	                            (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+
+	/*!
+	 * @brief Store a value atomically and make it persistent
+	 * @tparam NVMType The configuration of flush and fence
+	 * @param addr The destination on NVM, naturally aligned
+	 * @param value The value to store
+	 * @param flags Only NO_DRAIN is accepted, which leaves the fence to the caller
+	 */
+	template<class NVMType = NVM, PersistAtomicType T>
+	inline void persist_store(T *addr, T value, PersistFlag flags = PersistFlag::NONE) {
+		static_assert(alignof(T) >= sizeof(T), "Type should be naturally aligned, so that the value never straddles cache lines");
+		assert(reinterpret_cast<uintptr_t>(addr) % sizeof(T) == 0);
+
+		std::atomic_ref<T>(*addr).store(value, std::memory_order::release);
+		NVMType::pwb(addr);
+		if (!has_persist_flag(flags, PersistFlag::NO_DRAIN)) {
+			NVMType::fence();
+		}
+	}
+
+	template<class NVMType = NVM, PersistAtomicType T>
+	inline void persist_store(std::atomic<T> *addr, T value, PersistFlag flags = PersistFlag::NONE) {
+		static_assert(alignof(std::atomic<T>) >= sizeof(T), "Type should be naturally aligned, so that the value never straddles cache lines");
+
+		addr->store(value, std::memory_order::release);
+		NVMType::pwb(addr);
+		if (!has_persist_flag(flags, PersistFlag::NO_DRAIN)) {
+			NVMType::fence();
+		}
+	}
+
+	/*!
+	 * @brief Compare and swap atomically, and make the new value persistent on success.
+	 * Nothing is flushed on failure: if the caller depends on the value loaded into expected,
+	 * which may be unpersisted, it should flush the line itself.
+	 * @tparam NVMType The configuration of flush and fence
+	 * @param addr The destination on NVM, naturally aligned
+	 * @param expected The expected value, updated with the current value on failure
+	 * @param desired The new value
+	 * @param flags Only NO_DRAIN is accepted, which leaves the fence to the caller
+	 * @return Whether the swap succeeds
+	 */
+	template<class NVMType = NVM, PersistAtomicType T>
+	inline bool persist_cas(T *addr, T &expected, T desired, PersistFlag flags = PersistFlag::NONE) {
+		static_assert(alignof(T) >= sizeof(T), "Type should be naturally aligned, so that the value never straddles cache lines");
+		assert(reinterpret_cast<uintptr_t>(addr) % sizeof(T) == 0);
+
+		if (!std::atomic_ref<T>(*addr).compare_exchange_strong(expected, desired, std::memory_order::acq_rel)) {
+			return false;
+		}
+		NVMType::pwb(addr);
+		if (!has_persist_flag(flags, PersistFlag::NO_DRAIN)) {
+			NVMType::fence();
+		}
+		return true;
+	}
+
+	template<class NVMType = NVM, PersistAtomicType T>
+	inline bool persist_cas(std::atomic<T> *addr, T &expected, T desired, PersistFlag flags = PersistFlag::NONE) {
+		static_assert(alignof(std::atomic<T>) >= sizeof(T), "Type should be naturally aligned, so that the value never straddles cache lines");
+
+		if (!addr->compare_exchange_strong(expected, desired, std::memory_order::acq_rel)) {
+			return false;
+		}
+		NVMType::pwb(addr);
+		if (!has_persist_flag(flags, PersistFlag::NO_DRAIN)) {
+			NVMType::fence();
+		}
+		return true;
+	}
+
+	/*!
+	 * @brief Compare and swap 16 bytes atomically by cmpxchg16b, e.g. a pointer with its version,
+	 * and make the new value persistent on success. See persist_cas() for the failure case.
+	 * @tparam NVMType The configuration of flush and fence
+	 * @param addr The destination on NVM, aligned to 16 bytes
+	 * @param expected The expected value, updated with the current value on failure
+	 * @param desired The new value
+	 * @param flags Only NO_DRAIN is accepted, which leaves the fence to the caller
+	 * @return Whether the swap succeeds
+	 */
+	template<class NVMType = NVM, class T>
+	inline bool persist_cas128(T *addr, T &expected, const T &desired, PersistFlag flags = PersistFlag::NONE) {
+		static_assert(std::is_trivially_copyable_v<T> && sizeof(T) == 16, "cmpxchg16b works on 16-byte values");
+		static_assert(alignof(T) >= 16, "Type should be aligned to 16 bytes, as required by cmpxchg16b");
+		assert(reinterpret_cast<uintptr_t>(addr) % 16 == 0);
+
+		if (!util::cas128(addr, expected, desired)) {
+			return false;
+		}
+		NVMType::pwb(addr);
+		if (!has_persist_flag(flags, PersistFlag::NO_DRAIN)) {
+			NVMType::fence();
+		}
+		return true;
+	}
+
+}
+
+#endif //UTIL_MEM_PERSIST_H
@@ -0,0 +1,178 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/6/29
+ */
+
+#pragma once
+#ifndef UTIL_MEM_PERSIST_STATS_H
+#define UTIL_MEM_PERSIST_STATS_H
+
+#include <cstdint>
+#include <atomic>
+#include <tuple>
+#include <string_view>
+
+#include <memory/cache_config.h>
+
+/*
+ * Statistics of persistence instructions: flushed cache lines, fences and bytes written by
+ * non-temporal kernels. Counting is enabled only if PERSIST_STATS_DEFINED is defined,
+ * otherwise all counting hooks are empty and no storage is allocated.
+ */
+
+#ifdef PERSIST_STATS_DEFINED
+	#include <thread/thread.h>
+	#include <logger/logger.h>
+#endif
+
+inline namespace util_mem {
+
+	#ifdef PERSIST_STATS_DEFINED
+		constexpr bool PERSIST_STATS_ENABLE = true;
+	#else
+		constexpr bool PERSIST_STATS_ENABLE = false;
+	#endif
+
+	/*!
+	 * @brief Aggregated statistics of persistence instructions
+	 */
+	struct PersistStat {
+		/// The number of flushed cache lines
+		uint64_t pwb_count;
+		/// The number of issued fences
+		uint64_t fence_count;
+		/// The number of bytes written by non-temporal kernels
+		uint64_t nt_bytes;
+	};
+
+#ifdef PERSIST_STATS_DEFINED
+
+	/*!
+	 * @brief Per-thread counters padded to cache line, indexed by thread::get_tid().
+	 * Registered threads own their slots and update them without atomic RMW.
+	 * All unregistered threads share the last slot, which is updated by fetch_add.
+	 */
+	class PersistStatRecorder {
+	private:
+		struct alignas(CACHE_LINE_SIZE) Counter {
+			std::atomic<uint64_t> pwb_count{0};
+			std::atomic<uint64_t> fence_count{0};
+			std::atomic<uint64_t> nt_bytes{0};
+		};
+
+		static constexpr int NUM_SLOT = thread::MAX_TID + 1;
+
+		static constexpr int SHARED_SLOT = thread::MAX_TID;
+
+	private:
+		Counter counter_array_[NUM_SLOT];
+
+	public:
+		__attribute__((always_inline)) void add_pwb(uint64_t value) {
+			add(&Counter::pwb_count, value);
+		}
+
+		__attribute__((always_inline)) void add_fence(uint64_t value) {
+			add(&Counter::fence_count, value);
+		}
+
+		__attribute__((always_inline)) void add_nt_bytes(uint64_t value) {
+			add(&Counter::nt_bytes, value);
+		}
+
+		[[nodiscard]] PersistStat collect() const {
+			PersistStat stat{0, 0, 0};
+			for (const auto &counter: counter_array_) {
+				stat.pwb_count   += counter.pwb_count.load(std::memory_order::relaxed);
+				stat.fence_count += counter.fence_count.load(std::memory_order::relaxed);
+				stat.nt_bytes    += counter.nt_bytes.load(std::memory_order::relaxed);
+			}
+			return stat;
+		}
+
+		void reset() {
+			for (auto &counter: counter_array_) {
+				counter.pwb_count.store(0, std::memory_order::relaxed);
+				counter.fence_count.store(0, std::memory_order::relaxed);
+				counter.nt_bytes.store(0, std::memory_order::relaxed);
+			}
+		}
+
+	private:
+		__attribute__((always_inline)) void add(std::atomic<uint64_t> Counter::*member, uint64_t value) {
+			uint32_t tid = thread::get_tid();
+			if (tid < static_cast<uint32_t>(thread::MAX_TID)) [[likely]] {
+				std::atomic<uint64_t> &target = counter_array_[tid].*member;
+				target.store(target.load(std::memory_order::relaxed) + value, std::memory_order::relaxed);
+			}
+			else {
+				(counter_array_[SHARED_SLOT].*member).fetch_add(value, std::memory_order::relaxed);
+			}
+		}
+	};
+
+	inline PersistStatRecorder PERSIST_STAT_RECORDER;
+
+#endif
+
+	__attribute__((always_inline)) inline void persist_stat_add_pwb([[maybe_unused]] uint64_t num_line = 1) {
+		#ifdef PERSIST_STATS_DEFINED
+			PERSIST_STAT_RECORDER.add_pwb(num_line);
+		#endif
+	}
+
+	__attribute__((always_inline)) inline void persist_stat_add_fence() {
+		#ifdef PERSIST_STATS_DEFINED
+			PERSIST_STAT_RECORDER.add_fence(1);
+		#endif
+	}
+
+	__attribute__((always_inline)) inline void persist_stat_add_nt_bytes([[maybe_unused]] uint64_t num_byte) {
+		#ifdef PERSIST_STATS_DEFINED
+			PERSIST_STAT_RECORDER.add_nt_bytes(num_byte);
+		#endif
+	}
+
+	/*!
+	 * @brief Sum up counters of all threads. All zero if statistics are compiled out.
+	 */
+	inline PersistStat collect_persist_stat() {
+		#ifdef PERSIST_STATS_DEFINED
+			return PERSIST_STAT_RECORDER.collect();
+		#else
+			return {0, 0, 0};
+		#endif
+	}
+
+	/*!
+	 * @brief Clear counters of all threads. Should not run concurrently with persistence operations.
+	 */
+	inline void reset_persist_stat() {
+		#ifdef PERSIST_STATS_DEFINED
+			PERSIST_STAT_RECORDER.reset();
+		#endif
+	}
+
+	/*!
+	 * @brief Print the aggregated statistics by logger_print_property
+	 * @param header_name The header of output, e.g. the name of workload
+	 * @param num_op The number of operations (e.g. transactions) for per-operation average, 0 to omit
+	 */
+	inline void print_persist_stat([[maybe_unused]] std::string_view header_name, [[maybe_unused]] uint64_t num_op = 0) {
+		#ifdef PERSIST_STATS_DEFINED
+			PersistStat stat = collect_persist_stat();
+			double divisor   = num_op == 0 ? 1.0 : static_cast<double>(num_op);
+			util::logger_print_property(header_name,
+			                            std::make_tuple("Operation", num_op, ""),
+			                            std::make_tuple("PWB", stat.pwb_count, "line"),
+			                            std::make_tuple("Fence", stat.fence_count, ""),
+			                            std::make_tuple("NT bytes", stat.nt_bytes, "B"),
+			                            std::make_tuple("PWB per op", stat.pwb_count / divisor, "line"),
+			                            std::make_tuple("Fence per op", stat.fence_count / divisor, ""),
+			                            std::make_tuple("NT bytes per op", stat.nt_bytes / divisor, "B"));
+		#endif
+	}
+
+}
+
+#endif //UTIL_MEM_PERSIST_STATS_H
@@ -0,0 +1,468 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/6
+ */
+
+#pragma once
+#ifndef UTIL_MEM_PERSISTENT_ALLOCATOR_H
+#define UTIL_MEM_PERSISTENT_ALLOCATOR_H
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <util/utility_macro.h>
+#include <thread/thread.h>
+#include <thread/thread_numa.h>
+#include <thread/thread_worker.h>
+#include <memory/memory_config.h>
+#include <memory/nvm_config.h>
+#include <memory/file_descriptor.h>
+
+inline namespace util_mem {
+
+	/*
+	 * Crash-consistent slab allocator inside the data area of a FileDescriptor.
+	 *
+	 * The area is divided into slabs of PERSISTENT_SLAB_SIZE. Each slab starts with a header holding
+	 * its size class and an allocation bitmap, followed by blocks of the class. The headers are the
+	 * only persistent metadata: a block is allocated iff its bit is set. A slab gets its class
+	 * (persisted before any of its blocks is handed out) when it is used for the first time.
+	 *
+	 * Free blocks are tracked in DRAM by per-thread caches (indexed by thread::get_tid()) and a
+	 * central list per class, which are rebuilt from bitmaps by parallel recovery after restart.
+	 */
+
+	constexpr size_t PERSISTENT_SLAB_SIZE = 256_KB;
+
+	namespace persistent_allocator_detail {
+
+		/// Size classes, which are part of the persistent layout and should never be changed
+		inline constexpr std::array<uint32_t, 14> SIZE_CLASS_ARRAY = {
+			64, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096, 8192, 16384
+		};
+
+		inline constexpr uint32_t NUM_SIZE_CLASS = SIZE_CLASS_ARRAY.size();
+
+		inline constexpr uint32_t MAX_BLOCK_SIZE = SIZE_CLASS_ARRAY.back();
+
+		/// Size of the fixed part of slab header
+		inline constexpr size_t SLAB_META_SIZE = 16;
+
+		inline constexpr size_t get_header_size(size_t num_block) {
+			return util_macro::align_ceil(SLAB_META_SIZE + (num_block + 63) / 64 * sizeof(uint64_t), CACHE_LINE_SIZE);
+		}
+
+		inline constexpr uint32_t get_num_block(uint32_t size_class) {
+			size_t block_size = SIZE_CLASS_ARRAY[size_class];
+			size_t num_block  = PERSISTENT_SLAB_SIZE / block_size;
+			while (get_header_size(num_block) + num_block * block_size > PERSISTENT_SLAB_SIZE) {
+				--num_block;
+			}
+			return num_block;
+		}
+
+		inline constexpr uint32_t get_size_class(size_t size) {
+			uint32_t size_class = 0;
+			while (SIZE_CLASS_ARRAY[size_class] < size) {
+				++size_class;
+			}
+			return size_class;
+		}
+
+		/*!
+		 * @brief Persistent header at the beginning of each slab
+		 */
+		struct SlabHeader {
+			/// Size class plus 1, 0 if the slab is unused
+			uint32_t class_tag;
+			/// The number of blocks, for validation
+			uint32_t num_block;
+			uint64_t reserved;
+			/// 1 for allocated blocks
+			std::atomic<uint64_t> bitmap[];
+		};
+
+		static_assert(offsetof(SlabHeader, bitmap) == SLAB_META_SIZE);
+
+	}
+
+	/*!
+	 * @brief A block taken by reserve(), which is not allocated persistently until publish().
+	 */
+	struct PersistentReservation {
+		/// The address of block
+		void *ptr;
+		/// The size of block, which may be larger than requested
+		uint32_t block_size;
+	};
+
+	template<class NVMType = NVM>
+	class PersistentAllocator {
+	private:
+		using SlabHeader = persistent_allocator_detail::SlabHeader;
+
+		static constexpr uint32_t NUM_SIZE_CLASS = persistent_allocator_detail::NUM_SIZE_CLASS;
+
+		/// The number of blocks moved between thread cache and central list at a time
+		static constexpr uint32_t BATCH_SIZE = 32;
+
+		static constexpr uint32_t CACHE_CAPACITY = BATCH_SIZE * 2;
+
+		struct CacheList {
+			uint32_t size = 0;
+			/// Offsets of free blocks from the start of data area
+			uint64_t offset_array[CACHE_CAPACITY];
+		};
+
+		struct alignas(CACHE_LINE_SIZE) ThreadCache {
+			CacheList cache_list_array[NUM_SIZE_CLASS];
+		};
+
+		struct alignas(CACHE_LINE_SIZE) CentralList {
+			std::mutex mutex;
+			std::vector<uint64_t> offset_array;
+		};
+
+	private:
+		FileDescriptor &file_;
+
+		uint8_t *start_ptr_;
+
+		size_t num_slab_;
+
+		std::unique_ptr<ThreadCache[]> cache_array_;
+
+		CentralList central_array_[NUM_SIZE_CLASS];
+
+		std::mutex slab_mutex_;
+		/// Unused slabs
+		std::vector<uint64_t> free_slab_array_;
+
+	public:
+		/*!
+		 * @brief Manage the data area of file. Existing allocations are recovered from slab headers.
+		 * @param file The mapped pool
+		 * @param num_recovery_thread The number of workers scanning slab headers
+		 */
+		explicit PersistentAllocator(FileDescriptor &file, int num_recovery_thread = 1):
+				file_(file), start_ptr_(file.aligned_start_ptr), num_slab_(file.aligned_total_size / PERSISTENT_SLAB_SIZE),
+				cache_array_(std::make_unique<ThreadCache[]>(thread::MAX_TID)) {
+
+			recover(num_recovery_thread);
+		}
+
+		PersistentAllocator(const PersistentAllocator &other) = delete;
+
+		~PersistentAllocator() = default;
+
+	public:
+		/*!
+		 * @brief Allocate a block persistently, which costs one flush and one fence.
+		 * @return The block, or nullptr if size is too large or the pool is full
+		 */
+		void *allocate(size_t size) {
+			PersistentReservation reservation = reserve(size);
+			if (reservation.ptr == nullptr) {
+				return nullptr;
+			}
+			publish(reservation);
+			NVMType::fence();
+			return reservation.ptr;
+		}
+
+		/*!
+		 * @brief Take a free block without persisting the allocation.
+		 * The caller writes and flushes data, calls publish(), and then issues one fence
+		 * which persists both the data and the allocation. Until publish(), cancel() returns the block.
+		 */
+		PersistentReservation reserve(size_t size) {
+			if (size > persistent_allocator_detail::MAX_BLOCK_SIZE || size == 0) [[unlikely]] {
+				return { nullptr, 0 };
+			}
+
+			uint32_t size_class = persistent_allocator_detail::get_size_class(size);
+			uint64_t offset;
+			uint32_t tid = thread::get_tid();
+			if (tid < static_cast<uint32_t>(thread::MAX_TID)) [[likely]] {
+				CacheList &cache_list = cache_array_[tid].cache_list_array[size_class];
+				if (cache_list.size == 0 && !refill(cache_list, size_class)) {
+					return { nullptr, 0 };
+				}
+				offset = cache_list.offset_array[--cache_list.size];
+			}
+			else {
+				uint64_t offset_array[1];
+				if (take_from_central(size_class, offset_array, 1) == 0) {
+					return { nullptr, 0 };
+				}
+				offset = offset_array[0];
+			}
+			return { start_ptr_ + offset, persistent_allocator_detail::SIZE_CLASS_ARRAY[size_class] };
+		}
+
+		/*!
+		 * @brief Mark the reserved block allocated and flush the bit, without fence.
+		 */
+		void publish(const PersistentReservation &reservation) {
+			auto [header, block_id] = locate(reservation.ptr);
+			std::atomic<uint64_t> &word = header->bitmap[block_id / 64];
+			uint64_t old_word = word.fetch_or(1ULL << (block_id % 64), std::memory_order::relaxed);
+			assert((old_word & (1ULL << (block_id % 64))) == 0 && "Block is published twice");
+			static_cast<void>(old_word);
+			NVMType::pwb(&word);
+		}
+
+		/*!
+		 * @brief Give up a reserved block which has not been published
+		 */
+		void cancel(const PersistentReservation &reservation) {
+			put_free_block(reservation.ptr);
+		}
+
+		/*!
+		 * @brief Free an allocated block persistently
+		 * @param ptr The block
+		 * @param drain Whether to issue fence. Without fence, the free is persisted by the next fence of this thread.
+		 */
+		void deallocate(void *ptr, bool drain = true) {
+			if (ptr == nullptr) [[unlikely]] {
+				return;
+			}
+			auto [header, block_id] = locate(ptr);
+			std::atomic<uint64_t> &word = header->bitmap[block_id / 64];
+			uint64_t old_word = word.fetch_and(~(1ULL << (block_id % 64)), std::memory_order::relaxed);
+			assert((old_word & (1ULL << (block_id % 64))) != 0 && "Double free of persistent block");
+			static_cast<void>(old_word);
+			NVMType::pwb(&word);
+			if (drain) {
+				NVMType::fence();
+			}
+
+			put_free_block(ptr);
+		}
+
+		/*!
+		 * @brief Whether the block is allocated persistently
+		 */
+		[[nodiscard]] bool is_allocated(const void *ptr) const {
+			auto [header, block_id] = locate(ptr);
+			return (header->bitmap[block_id / 64].load(std::memory_order::relaxed) >> (block_id % 64)) & 1;
+		}
+
+		/*!
+		 * @brief Visit all allocated blocks, e.g. to rebuild volatile indexes after restart
+		 * @param func Called as func(void *block, uint32_t block_size)
+		 */
+		template<class Func>
+		void for_each_allocated(Func &&func) const {
+			for (size_t slab_id = 0; slab_id < num_slab_; ++slab_id) {
+				SlabHeader *header = get_slab_header(slab_id);
+				if (header->class_tag == 0) { continue; }
+
+				uint32_t size_class = header->class_tag - 1;
+				uint32_t block_size = persistent_allocator_detail::SIZE_CLASS_ARRAY[size_class];
+				uint8_t *data_ptr   = get_slab_data(slab_id, size_class);
+				for (uint32_t block_id = 0; block_id < header->num_block; ++block_id) {
+					if ((header->bitmap[block_id / 64].load(std::memory_order::relaxed) >> (block_id % 64)) & 1) {
+						func(static_cast<void *>(data_ptr + static_cast<size_t>(block_id) * block_size), block_size);
+					}
+				}
+			}
+		}
+
+		/*!
+		 * @brief Return blocks cached by the current thread to central lists, e.g. before the thread exits.
+		 */
+		void flush_thread_cache() {
+			uint32_t tid = thread::get_tid();
+			if (tid >= static_cast<uint32_t>(thread::MAX_TID)) {
+				return;
+			}
+			for (uint32_t size_class = 0; size_class < NUM_SIZE_CLASS; ++size_class) {
+				CacheList &cache_list = cache_array_[tid].cache_list_array[size_class];
+				give_to_central(size_class, cache_list.offset_array, cache_list.size);
+				cache_list.size = 0;
+			}
+		}
+
+		[[nodiscard]] uint64_t get_offset(const void *ptr) const {
+			return static_cast<const uint8_t *>(ptr) - start_ptr_;
+		}
+
+		[[nodiscard]] void *get_pointer(uint64_t offset) const {
+			return start_ptr_ + offset;
+		}
+
+	private:
+		[[nodiscard]] SlabHeader *get_slab_header(size_t slab_id) const {
+			return reinterpret_cast<SlabHeader *>(start_ptr_ + slab_id * PERSISTENT_SLAB_SIZE);
+		}
+
+		[[nodiscard]] uint8_t *get_slab_data(size_t slab_id, uint32_t size_class) const {
+			uint32_t num_block = persistent_allocator_detail::get_num_block(size_class);
+			return start_ptr_ + slab_id * PERSISTENT_SLAB_SIZE + persistent_allocator_detail::get_header_size(num_block);
+		}
+
+		/*!
+		 * @brief Find the slab header and index of block
+		 */
+		[[nodiscard]] std::pair<SlabHeader *, uint32_t> locate(const void *ptr) const {
+			uint64_t offset    = get_offset(ptr);
+			size_t slab_id     = offset / PERSISTENT_SLAB_SIZE;
+			SlabHeader *header = get_slab_header(slab_id);
+			assert(slab_id < num_slab_ && header->class_tag != 0);
+
+			uint32_t size_class = header->class_tag - 1;
+			uint8_t *data_ptr   = get_slab_data(slab_id, size_class);
+			auto block_id       = static_cast<uint32_t>((static_cast<const uint8_t *>(ptr) - data_ptr) / persistent_allocator_detail::SIZE_CLASS_ARRAY[size_class]);
+			return { header, block_id };
+		}
+
+		void put_free_block(void *ptr) {
+			auto [header, block_id] = locate(ptr);
+			uint32_t size_class = header->class_tag - 1;
+			uint64_t offset     = get_offset(ptr);
+
+			uint32_t tid = thread::get_tid();
+			if (tid >= static_cast<uint32_t>(thread::MAX_TID)) [[unlikely]] {
+				give_to_central(size_class, &offset, 1);
+				return;
+			}
+
+			CacheList &cache_list = cache_array_[tid].cache_list_array[size_class];
+			if (cache_list.size == CACHE_CAPACITY) [[unlikely]] {
+				cache_list.size -= BATCH_SIZE;
+				give_to_central(size_class, cache_list.offset_array + cache_list.size, BATCH_SIZE);
+			}
+			cache_list.offset_array[cache_list.size++] = offset;
+		}
+
+		bool refill(CacheList &cache_list, uint32_t size_class) {
+			cache_list.size = take_from_central(size_class, cache_list.offset_array, BATCH_SIZE);
+			return cache_list.size > 0;
+		}
+
+		size_t take_from_central(uint32_t size_class, uint64_t *offset_array, size_t num) {
+			CentralList &central = central_array_[size_class];
+			std::lock_guard<std::mutex> lock(central.mutex);
+			if (central.offset_array.empty() && !assign_slab(size_class, central.offset_array)) {
+				return 0;
+			}
+
+			size_t num_taken = std::min(num, central.offset_array.size());
+			std::copy(central.offset_array.end() - num_taken, central.offset_array.end(), offset_array);
+			central.offset_array.resize(central.offset_array.size() - num_taken);
+			return num_taken;
+		}
+
+		void give_to_central(uint32_t size_class, const uint64_t *offset_array, size_t num) {
+			CentralList &central = central_array_[size_class];
+			std::lock_guard<std::mutex> lock(central.mutex);
+			central.offset_array.insert(central.offset_array.end(), offset_array, offset_array + num);
+		}
+
+		/*!
+		 * @brief Assign an unused slab to the size class persistently, and collect its blocks
+		 */
+		bool assign_slab(uint32_t size_class, std::vector<uint64_t> &offset_array) {
+			uint64_t slab_id;
+			{
+				std::lock_guard<std::mutex> lock(slab_mutex_);
+				if (free_slab_array_.empty()) {
+					return false;
+				}
+				slab_id = free_slab_array_.back();
+				free_slab_array_.pop_back();
+			}
+
+			uint32_t num_block = persistent_allocator_detail::get_num_block(size_class);
+			SlabHeader *header = get_slab_header(slab_id);
+			for (uint32_t i = 0; i < (num_block + 63) / 64; ++i) {
+				header->bitmap[i].store(0, std::memory_order::relaxed);
+			}
+			header->num_block = num_block;
+			header->reserved  = 0;
+			NVMType::pwb_range(header, persistent_allocator_detail::get_header_size(num_block));
+			NVMType::fence();
+			// The class is persisted after a clean bitmap
+			header->class_tag = size_class + 1;
+			NVMType::pwb(header);
+			NVMType::fence();
+
+			collect_free_blocks(slab_id, offset_array);
+			return true;
+		}
+
+		void collect_free_blocks(size_t slab_id, std::vector<uint64_t> &offset_array) const {
+			SlabHeader *header  = get_slab_header(slab_id);
+			uint32_t size_class = header->class_tag - 1;
+			uint32_t block_size = persistent_allocator_detail::SIZE_CLASS_ARRAY[size_class];
+			uint64_t data_offset = get_offset(get_slab_data(slab_id, size_class));
+
+			// Push in reverse order, so that blocks are taken from low address
+			for (uint32_t block_id = header->num_block; block_id-- > 0;) {
+				if (((header->bitmap[block_id / 64].load(std::memory_order::relaxed) >> (block_id % 64)) & 1) == 0) {
+					offset_array.emplace_back(data_offset + static_cast<uint64_t>(block_id) * block_size);
+				}
+			}
+		}
+
+		/*!
+		 * @brief Rebuild free lists from slab headers, with workers on the numa node owning the device.
+		 * Each worker scans a contiguous range of slabs, and results are merged into central lists.
+		 */
+		void recover(int num_thread) {
+			num_thread = std::max(1, std::min<int>(num_thread, static_cast<int>(std::max<size_t>(num_slab_, 1))));
+
+			struct RecoveryResult {
+				std::vector<uint64_t> free_slab_array;
+				std::vector<uint64_t> offset_array[NUM_SIZE_CLASS];
+			};
+			std::vector<RecoveryResult> result_array(num_thread);
+
+			auto scan = [&](int worker_id) {
+				RecoveryResult &result = result_array[worker_id];
+				size_t slab_begin = num_slab_ * worker_id / num_thread;
+				size_t slab_end   = num_slab_ * (worker_id + 1) / num_thread;
+				for (size_t slab_id = slab_begin; slab_id < slab_end; ++slab_id) {
+					SlabHeader *header = get_slab_header(slab_id);
+					uint32_t class_tag = header->class_tag;
+					if (class_tag == 0 || class_tag > NUM_SIZE_CLASS ||
+					    header->num_block != persistent_allocator_detail::get_num_block(class_tag - 1)) {
+						// Unused, or torn by a crash during assignment
+						header->class_tag = 0;
+						result.free_slab_array.emplace_back(slab_id);
+						continue;
+					}
+					collect_free_blocks(slab_id, result.offset_array[class_tag - 1]);
+				}
+			};
+
+			if (num_thread == 1) {
+				scan(0);
+			}
+			else {
+				thread::run_workers_on_node(thread::NUMAConfig::get_node_of_file(file_.file_path), num_thread, scan);
+			}
+
+			// Merge in reverse order, so that unused slabs of low address are taken first
+			for (int worker_id = num_thread - 1; worker_id >= 0; --worker_id) {
+				RecoveryResult &result = result_array[worker_id];
+				free_slab_array_.insert(free_slab_array_.end(), result.free_slab_array.rbegin(), result.free_slab_array.rend());
+				for (uint32_t size_class = 0; size_class < NUM_SIZE_CLASS; ++size_class) {
+					auto &offset_array = central_array_[size_class].offset_array;
+					offset_array.insert(offset_array.end(), result.offset_array[size_class].begin(), result.offset_array[size_class].end());
+				}
+			}
+		}
+	};
+
+}
+
+#endif //UTIL_MEM_PERSISTENT_ALLOCATOR_H
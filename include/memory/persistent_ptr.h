@@ -0,0 +1,255 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/7
+ */
+
+#pragma once
+#ifndef UTIL_MEM_PERSISTENT_PTR_H
+#define UTIL_MEM_PERSISTENT_PTR_H
+
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <type_traits>
+
+#include <logger/logger.h>
+#include <memory/file_descriptor.h>
+
+/*
+ * Pointers into persistent pools, which keep valid after the pool is mapped at another address.
+ *
+ * A persistent_ptr stores a 16-bit pool id and a 48-bit offset from the base of pool in one 64-bit word,
+ * so that it is trivially copyable and can be updated by atomic 8-byte stores.
+ * Pools are registered with their base address at runtime. Only the word 0, i.e. offset 0 of pool 0, is null,
+ * which never refers to an object in FileDescriptor as the pool header lies there. Offset 0 of other pools
+ * is a valid (non-null) pointer to the base of pool.
+ */
+
+inline namespace util_mem {
+
+	/// The max number of pools registered at the same time
+	#ifndef PERSISTENT_POOL_MAX_NUM_DEFINED
+		constexpr uint32_t PERSISTENT_POOL_MAX_NUM = 256;
+	#else
+		constexpr uint32_t PERSISTENT_POOL_MAX_NUM = PERSISTENT_POOL_MAX_NUM_DEFINED;
+	#endif
+
+	static_assert(PERSISTENT_POOL_MAX_NUM <= (1U << 16), "Pool id of persistent_ptr has only 16 bits");
+
+	/*!
+	 * @brief Map pool ids to base addresses of current mapping.
+	 * Registration is rare, and each change increases the epoch, which invalidates thread-local caches.
+	 */
+	class PersistentPoolRegistry {
+	private:
+		std::atomic<uint8_t *> base_array_[PERSISTENT_POOL_MAX_NUM];
+
+		std::atomic<size_t> size_array_[PERSISTENT_POOL_MAX_NUM];
+
+		std::atomic<uint64_t> epoch_;
+
+	public:
+		PersistentPoolRegistry(): epoch_(1) {
+			for (uint32_t i = 0; i < PERSISTENT_POOL_MAX_NUM; ++i) {
+				base_array_[i].store(nullptr, std::memory_order::relaxed);
+				size_array_[i].store(0, std::memory_order::relaxed);
+			}
+		}
+
+	public:
+		/*!
+		 * @brief Bind a pool id to the base address of its current mapping
+		 * @param pool_id The id, which should be the same for the pool across restarts
+		 * @param base_ptr The address that offsets are relative to
+		 * @param size The size of pool
+		 */
+		void register_pool(uint16_t pool_id, void *base_ptr, size_t size) {
+			if (pool_id >= PERSISTENT_POOL_MAX_NUM) {
+				util::logger_exception("Pool id ", pool_id, " exceeds the max number of pools ", PERSISTENT_POOL_MAX_NUM);
+			}
+			size_array_[pool_id].store(size, std::memory_order::relaxed);
+			base_array_[pool_id].store(static_cast<uint8_t *>(base_ptr), std::memory_order::release);
+			epoch_.fetch_add(1, std::memory_order::acq_rel);
+		}
+
+		/*!
+		 * @brief Register the whole mapping of file, so that offsets are relative to the start of file
+		 */
+		void register_pool(uint16_t pool_id, const FileDescriptor &file) {
+			register_pool(pool_id, file.start_ptr, file.total_size);
+		}
+
+		void unregister_pool(uint16_t pool_id) {
+			if (pool_id >= PERSISTENT_POOL_MAX_NUM) {
+				util::logger_exception("Pool id ", pool_id, " exceeds the max number of pools ", PERSISTENT_POOL_MAX_NUM);
+			}
+			base_array_[pool_id].store(nullptr, std::memory_order::release);
+			size_array_[pool_id].store(0, std::memory_order::relaxed);
+			epoch_.fetch_add(1, std::memory_order::acq_rel);
+		}
+
+		/*!
+		 * @brief Get the base address of pool, or nullptr if the pool is not registered.
+		 * Pool ids out of range (e.g. read from a corrupted pointer) are regarded as unregistered.
+		 */
+		[[nodiscard]] uint8_t *get_base(uint16_t pool_id) const {
+			if (pool_id >= PERSISTENT_POOL_MAX_NUM) [[unlikely]] {
+				return nullptr;
+			}
+			return base_array_[pool_id].load(std::memory_order::acquire);
+		}
+
+		[[nodiscard]] uint64_t get_epoch() const {
+			return epoch_.load(std::memory_order::acquire);
+		}
+
+		/*!
+		 * @brief Find the pool containing the address, which is a linear scan.
+		 * @return Whether the pool is found
+		 */
+		bool find_pool(const void *ptr, uint16_t &pool_id, uint64_t &offset) const {
+			auto *byte_ptr = static_cast<const uint8_t *>(ptr);
+			for (uint32_t i = 0; i < PERSISTENT_POOL_MAX_NUM; ++i) {
+				uint8_t *base_ptr = get_base(i);
+				if (base_ptr != nullptr && byte_ptr >= base_ptr &&
+				    byte_ptr < base_ptr + size_array_[i].load(std::memory_order::relaxed)) {
+					pool_id = i;
+					offset  = byte_ptr - base_ptr;
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+
+	inline PersistentPoolRegistry PERSISTENT_POOL_REGISTRY;
+
+	/*!
+	 * @brief The last pool resolved by the current thread
+	 */
+	struct PoolBaseCache {
+		uint64_t epoch   = 0;
+		uint16_t pool_id = 0;
+		uint8_t *base    = nullptr;
+	};
+
+	inline thread_local PoolBaseCache POOL_BASE_CACHE;
+
+	/*!
+	 * @brief Get the base address of pool, through the thread-local cache in common case
+	 */
+	inline uint8_t *get_pool_base(uint16_t pool_id) {
+		PoolBaseCache &cache = POOL_BASE_CACHE;
+		uint64_t epoch = PERSISTENT_POOL_REGISTRY.get_epoch();
+		if (cache.pool_id == pool_id && cache.epoch == epoch) [[likely]] {
+			return cache.base;
+		}
+
+		cache.base    = PERSISTENT_POOL_REGISTRY.get_base(pool_id);
+		cache.pool_id = pool_id;
+		cache.epoch   = epoch;
+		assert(pool_id < PERSISTENT_POOL_MAX_NUM && "Pool id of persistent pointer exceeds the max number of pools");
+		assert(cache.base != nullptr && "Pool of persistent pointer is not registered");
+		return cache.base;
+	}
+
+	template<class T>
+	class persistent_ptr {
+	public:
+		static constexpr uint32_t OFFSET_BITS = 48;
+
+		static constexpr uint64_t OFFSET_MASK = (1ULL << OFFSET_BITS) - 1;
+
+	private:
+		/// Pool id in high 16 bits, and offset in low 48 bits. 0 (pool 0, offset 0) for null.
+		uint64_t raw_;
+
+	public:
+		persistent_ptr() = default;
+
+		constexpr persistent_ptr(std::nullptr_t): raw_(0) {}
+
+		constexpr persistent_ptr(uint16_t pool_id, uint64_t offset):
+				raw_((static_cast<uint64_t>(pool_id) << OFFSET_BITS) | offset) {
+			assert(offset <= OFFSET_MASK);
+		}
+
+		/*!
+		 * @brief Make a pointer to an address in a known pool
+		 */
+		static persistent_ptr from_pointer(uint16_t pool_id, const T *ptr) {
+			if (ptr == nullptr) { return nullptr; }
+			return { pool_id, static_cast<uint64_t>(reinterpret_cast<const uint8_t *>(ptr) - get_pool_base(pool_id)) };
+		}
+
+		/*!
+		 * @brief Make a pointer to an address, searching the pool containing it
+		 */
+		static persistent_ptr from_pointer(const T *ptr) {
+			uint16_t pool_id;
+			uint64_t offset;
+			if (ptr == nullptr || !PERSISTENT_POOL_REGISTRY.find_pool(ptr, pool_id, offset)) {
+				return nullptr;
+			}
+			return { pool_id, offset };
+		}
+
+		/*!
+		 * @brief Reinterpret a word loaded from persistent memory
+		 */
+		static constexpr persistent_ptr from_raw(uint64_t raw) {
+			persistent_ptr res;
+			res.raw_ = raw;
+			return res;
+		}
+
+	public:
+		/*!
+		 * @brief Resolve to the address in current mapping
+		 */
+		[[nodiscard]] T *get() const {
+			if (raw_ == 0) { return nullptr; }
+			return reinterpret_cast<T *>(get_pool_base(get_pool_id()) + get_offset());
+		}
+
+		T *operator->() const { return get(); }
+
+		template<class U = T> requires (!std::is_void_v<U>)
+		U &operator*() const { return *get(); }
+
+		template<class U = T> requires (!std::is_void_v<U>)
+		U &operator[](size_t index) const { return get()[index]; }
+
+		explicit constexpr operator bool() const { return raw_ != 0; }
+
+		constexpr bool operator==(const persistent_ptr &other) const = default;
+
+		/*!
+		 * @brief Cast to pointer of another type in the same pool
+		 */
+		template<class U>
+		[[nodiscard]] constexpr persistent_ptr<U> cast() const {
+			return persistent_ptr<U>::from_raw(raw_);
+		}
+
+		[[nodiscard]] constexpr uint16_t get_pool_id() const {
+			return static_cast<uint16_t>(raw_ >> OFFSET_BITS);
+		}
+
+		[[nodiscard]] constexpr uint64_t get_offset() const {
+			return raw_ & OFFSET_MASK;
+		}
+
+		[[nodiscard]] constexpr uint64_t get_raw() const {
+			return raw_;
+		}
+	};
+
+	static_assert(sizeof(persistent_ptr<int>) == 8);
+	static_assert(std::is_trivially_copyable_v<persistent_ptr<int>>);
+	static_assert(std::atomic<persistent_ptr<int>>::is_always_lock_free);
+
+}
+
+#endif //UTIL_MEM_PERSISTENT_PTR_H
@@ -0,0 +1,96 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/2
+ */
+
+#pragma once
+#ifndef UTIL_MEM_PREFAULT_H
+#define UTIL_MEM_PREFAULT_H
+
+#include <cstdint>
+#include <algorithm>
+
+#include <sys/mman.h>
+
+#include <util/utility_macro.h>
+#include <thread/thread_numa.h>
+#include <thread/thread_worker.h>
+#include <memory/memory_config.h>
+#include <memory/mapping.h>
+#include <memory/file_descriptor.h>
+
+#ifndef MADV_POPULATE_WRITE
+	#define MADV_POPULATE_WRITE 23
+#endif
+
+inline namespace util_mem {
+
+	/// The granularity of parts assigned to workers, which keeps huge pages in one worker
+	constexpr size_t PREFAULT_STRIPE_SIZE = HUGE_PAGE_2M_SIZE;
+
+	/*!
+	 * @brief Fault in pages of a mapped range for write by touching each page with an atomic add of zero,
+	 * which keeps data intact even if others are writing. It is the fallback of prefault_range().
+	 */
+	inline void prefault_range_by_touch(void *ptr, size_t size) {
+		auto *begin = reinterpret_cast<uint8_t *>(util_macro::floor_2pow(reinterpret_cast<uintptr_t>(ptr), MEM_PAGE_SIZE));
+		auto *end   = static_cast<uint8_t *>(ptr) + size;
+		for (uint8_t *page = begin; page < end; page += MEM_PAGE_SIZE) {
+			__atomic_fetch_add(page, 0, __ATOMIC_RELAXED);
+		}
+	}
+
+	/*!
+	 * @brief Fault in pages of a mapped range for write in the current thread.
+	 * MADV_POPULATE_WRITE (Linux 5.14) is used if possible, otherwise each page is touched.
+	 */
+	inline void prefault_range(void *ptr, size_t size) {
+		auto *begin = reinterpret_cast<uint8_t *>(util_macro::floor_2pow(reinterpret_cast<uintptr_t>(ptr), MEM_PAGE_SIZE));
+		auto *end   = static_cast<uint8_t *>(ptr) + size;
+		if (begin >= end) { return; }
+
+		if (madvise(begin, end - begin, MADV_POPULATE_WRITE) == 0) {
+			return;
+		}
+		prefault_range_by_touch(begin, end - begin);
+	}
+
+	/*!
+	 * @brief Fault in pages of a mapped range by several workers on specific numa node,
+	 * instead of MAP_POPULATE in the mapping thread.
+	 * @param ptr The start of range
+	 * @param size The size of range
+	 * @param num_thread The number of workers
+	 * @param numa_id The numa node where workers run, which should own the backing device
+	 */
+	inline void parallel_prefault(void *ptr, size_t size, int num_thread, int numa_id) {
+		auto *begin       = static_cast<uint8_t *>(ptr);
+		size_t num_stripe = (size + PREFAULT_STRIPE_SIZE - 1) / PREFAULT_STRIPE_SIZE;
+		if (num_thread <= 1 || num_stripe < static_cast<size_t>(num_thread)) {
+			prefault_range(begin, size);
+			return;
+		}
+
+		size_t stripe_per_thread = (num_stripe + num_thread - 1) / num_thread;
+		thread::run_workers_on_node(numa_id, num_thread, [&](int worker_id) {
+			size_t part_begin = std::min(size, worker_id * stripe_per_thread * PREFAULT_STRIPE_SIZE);
+			size_t part_end   = std::min(size, (worker_id + 1) * stripe_per_thread * PREFAULT_STRIPE_SIZE);
+			prefault_range(begin + part_begin, part_end - part_begin);
+		});
+	}
+
+	/*!
+	 * @brief Fault in the mapping of file by workers on the numa node owning its device.
+	 * The file should be mapped lazily (MapOption::populate = false).
+	 * @param file The mapped file
+	 * @param num_thread The number of workers
+	 * @param prefix_size Only fault in the hot prefix of mapping, leaving the rest faulted on demand. 0 for the whole mapping.
+	 */
+	inline void prefault_file(FileDescriptor &file, int num_thread, size_t prefix_size = 0) {
+		size_t size = prefix_size == 0 ? file.total_size : std::min<size_t>(prefix_size, file.total_size);
+		parallel_prefault(file.start_ptr, size, num_thread, thread::NUMAConfig::get_node_of_file(file.file_path));
+	}
+
+}
+
+#endif //UTIL_MEM_PREFAULT_H
@@ -7,6 +7,7 @@
 #ifndef UTIL_MEM_PREFETCH_H
 #define UTIL_MEM_PREFETCH_H
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 
@@ -0,0 +1,157 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/12
+ */
+
+#pragma once
+#ifndef UTIL_MEM_RECOVERY_SCANNER_H
+#define UTIL_MEM_RECOVERY_SCANNER_H
+
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <thread/thread.h>
+#include <thread/thread_worker.h>
+#include <memory/memory_config.h>
+#include <memory/file_descriptor.h>
+
+/*
+ * Parallel scan for crash recovery.
+ *
+ * Recovery is split into independent tasks (chunks of a region, or per-thread log segments), which
+ * are taken dynamically by workers on all numa nodes, bound to cpus allocated by THREAD_CONFIG.
+ * Each task validates its own data (checksum, sequence number) and emits items, which are sorted
+ * per task in parallel and then merged into one sequence ordered by key.
+ */
+
+inline namespace util_mem {
+
+	/// The default size of chunks when scanning a region
+	#ifndef RECOVERY_CHUNK_SIZE_DEFINED
+		constexpr size_t RECOVERY_CHUNK_SIZE = 64_MB;
+	#else
+		constexpr size_t RECOVERY_CHUNK_SIZE = RECOVERY_CHUNK_SIZE_DEFINED;
+	#endif
+
+	/*!
+	 * @brief Run tasks in parallel on all numa nodes, or in the calling thread if only one worker is needed.
+	 * @param num_task The number of tasks
+	 * @param func Called as func(task_id) once for each task
+	 * @param num_worker_per_node The number of workers on each node, or 0 for all cpus of the node
+	 */
+	template<class Func>
+	inline void parallel_for_each_task(size_t num_task, Func &&func, int num_worker_per_node = 0) {
+		if (num_task == 0) { return; }
+		if (num_task == 1 || (num_worker_per_node == 1 && thread::get_num_nodes() == 1)) {
+			for (size_t task_id = 0; task_id < num_task; ++task_id) {
+				func(task_id);
+			}
+			return;
+		}
+
+		std::atomic<size_t> next_task{0};
+		thread::run_workers_on_all_nodes(num_worker_per_node, static_cast<int>(std::min<size_t>(num_task, thread::MAX_TID)),
+		                                 [&](int, int) {
+			for (size_t task_id = next_task.fetch_add(1, std::memory_order::relaxed); task_id < num_task;
+			     task_id = next_task.fetch_add(1, std::memory_order::relaxed)) {
+				func(task_id);
+			}
+		});
+	}
+
+	/*!
+	 * @brief Scan tasks in parallel and merge emitted items in order of key.
+	 * Items with equal keys keep the order of task, and the order of emission within a task.
+	 * @tparam Item The type of results
+	 * @param num_task The number of tasks
+	 * @param scan Called as scan(task_id, std::vector<Item> &result), appending valid items to result
+	 * @param key Called as key(const Item &), returning a value comparable by operator<
+	 * @param num_worker_per_node The number of workers on each node, or 0 for all cpus of the node
+	 */
+	template<class Item, class ScanFunc, class KeyFunc>
+	inline std::vector<Item> parallel_scan(size_t num_task, ScanFunc &&scan, KeyFunc &&key, int num_worker_per_node = 0) {
+		std::vector<std::vector<Item>> task_result_array(num_task);
+		parallel_for_each_task(num_task, [&](size_t task_id) {
+			auto &task_result = task_result_array[task_id];
+			scan(task_id, task_result);
+			std::stable_sort(task_result.begin(), task_result.end(), [&](const Item &a, const Item &b) {
+				return key(a) < key(b);
+			});
+		}, num_worker_per_node);
+
+		// K-way merge of sorted results
+		using KeyType = std::decay_t<std::invoke_result_t<KeyFunc &, const Item &>>;
+		struct Cursor {
+			KeyType key;
+			size_t task_id;
+			size_t index;
+
+			bool operator>(const Cursor &other) const {
+				if (other.key < key) { return true; }
+				if (key < other.key) { return false; }
+				return task_id > other.task_id;
+			}
+		};
+
+		std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor>> heap;
+		size_t num_item = 0;
+		for (size_t task_id = 0; task_id < num_task; ++task_id) {
+			num_item += task_result_array[task_id].size();
+			if (!task_result_array[task_id].empty()) {
+				heap.push({ key(task_result_array[task_id][0]), task_id, 0 });
+			}
+		}
+
+		std::vector<Item> result;
+		result.reserve(num_item);
+		while (!heap.empty()) {
+			Cursor cursor = heap.top();
+			heap.pop();
+			auto &task_result = task_result_array[cursor.task_id];
+			result.emplace_back(std::move(task_result[cursor.index]));
+			if (++cursor.index < task_result.size()) {
+				cursor.key = key(task_result[cursor.index]);
+				heap.push(cursor);
+			}
+		}
+		return result;
+	}
+
+	/*!
+	 * @brief Split a region into chunks, scan them in parallel and merge items in order of key.
+	 * @param start_ptr The start of region
+	 * @param size The size of region
+	 * @param chunk_size The size of chunks, which should be a multiple of the unit of records
+	 * @param scan Called as scan(uint8_t *chunk_ptr, size_t chunk_size, size_t chunk_offset, std::vector<Item> &result)
+	 * @param key Called as key(const Item &)
+	 * @param num_worker_per_node The number of workers on each node, or 0 for all cpus of the node
+	 */
+	template<class Item, class ScanFunc, class KeyFunc>
+	inline std::vector<Item> parallel_scan_region(uint8_t *start_ptr, size_t size, size_t chunk_size,
+	                                              ScanFunc &&scan, KeyFunc &&key, int num_worker_per_node = 0) {
+		size_t num_chunk = (size + chunk_size - 1) / chunk_size;
+		return parallel_scan<Item>(num_chunk, [&](size_t chunk_id, std::vector<Item> &result) {
+			size_t chunk_offset = chunk_id * chunk_size;
+			scan(start_ptr + chunk_offset, std::min(chunk_size, size - chunk_offset), chunk_offset, result);
+		}, key, num_worker_per_node);
+	}
+
+	/*!
+	 * @brief Scan the data area of file in parallel, see parallel_scan_region()
+	 */
+	template<class Item, class ScanFunc, class KeyFunc>
+	inline std::vector<Item> parallel_scan_file(FileDescriptor &file, ScanFunc &&scan, KeyFunc &&key,
+	                                            size_t chunk_size = RECOVERY_CHUNK_SIZE, int num_worker_per_node = 0) {
+		return parallel_scan_region<Item>(file.aligned_start_ptr, file.aligned_total_size, chunk_size,
+		                                  std::forward<ScanFunc>(scan), std::forward<KeyFunc>(key), num_worker_per_node);
+	}
+
+}
+
+#endif //UTIL_MEM_RECOVERY_SCANNER_H
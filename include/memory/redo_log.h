@@ -0,0 +1,525 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/10
+ */
+
+#pragma once
+#ifndef UTIL_MEM_REDO_LOG_H
+#define UTIL_MEM_REDO_LOG_H
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <logger/logger.h>
+#include <util/utility_macro.h>
+#include <util/crc32c.h>
+#include <thread/thread.h>
+#include <memory/memory_config.h>
+#include <memory/ntstore.h>
+#include <memory/ntstore_crc32c.h>
+#include <memory/persist.h>
+#include <memory/nvm_config.h>
+#include <memory/file_descriptor.h>
+#include <memory/recovery_scanner.h>
+
+/*
+ * Append-only redo log in the data area of a FileDescriptor.
+ *
+ * The area is split into one segment per thread (plus one shared by unregistered threads),
+ * and each segment is a ring buffer of cache-line aligned records written by non-temporal stores.
+ * Records are made persistent in groups by commit(), which issues a single sfence.
+ *
+ * There is no commit marker: each record header carries a checksum, the sequence number in its
+ * segment and the epoch (the number of times the log was opened) it was written in. Recovery walks
+ * the chain from the head and stops at the first record which is torn (bad checksum), stale from an
+ * earlier lap (unexpected sequence number) or stale from before an earlier crash (older epoch than
+ * its predecessor). Records appended but not committed may or may not survive a crash.
+ * Epochs have 32 bits. A segment whose epoch would wrap is erased if it has no live record,
+ * otherwise the log refuses to open until its records are applied and truncated.
+ *
+ * The head of segment lives in two slots written alternately, so that a torn update of head
+ * leaves the other slot valid.
+ */
+
+inline namespace util_mem {
+
+	/*!
+	 * @brief A record visited after recovery
+	 */
+	struct RedoRecord {
+		/// The segment holding the record
+		uint32_t segment_id;
+		/// The sequence number in segment
+		uint64_t seq;
+		/// The value given to append(), e.g. commit timestamp to order records across segments
+		uint64_t key;
+		/// The logical position after the record, which can be passed to truncate()
+		uint64_t lsn;
+
+		const uint8_t *data;
+
+		uint32_t len;
+	};
+
+	namespace redo_log_detail {
+
+		enum class RecordType: uint16_t {
+			DATA = 1,
+			/// Padding to the end of ring
+			WRAP = 2
+		};
+
+		struct RecordHeader {
+			/// CRC32C of fields below and payload, never 0
+			uint32_t checksum;
+			uint32_t epoch;
+			uint64_t seq;
+			uint64_t key;
+			/// The length of payload, or of the skipped space for WRAP
+			uint32_t len;
+			RecordType type;
+			uint16_t reserved;
+		};
+
+		static_assert(sizeof(RecordHeader) == 32);
+
+		/*!
+		 * @brief Persistent head of segment
+		 */
+		struct alignas(CACHE_LINE_SIZE) HeadSlot {
+			/// Logical offset of the oldest record
+			uint64_t head;
+			/// The sequence number of the oldest record
+			uint64_t head_seq;
+			/// Larger for the newer slot
+			uint64_t generation;
+			uint64_t epoch;
+			/// CRC32C of fields above
+			uint64_t checksum;
+
+			[[nodiscard]] uint64_t compute_checksum() const {
+				return util::crc32c(this, offsetof(HeadSlot, checksum));
+			}
+		};
+
+		struct SegmentHeader {
+			HeadSlot slot_array[2];
+		};
+
+		/*!
+		 * @brief CRC32C of header fields after checksum, which payload is chained to
+		 */
+		inline uint32_t compute_header_crc(const RecordHeader &header) {
+			return util::crc32c(&header.epoch, sizeof(RecordHeader) - offsetof(RecordHeader, epoch));
+		}
+
+		inline uint32_t finish_checksum(uint32_t crc) {
+			// Never zero, so that a zeroed line is never a valid record
+			return crc == 0 ? 1 : crc;
+		}
+
+		inline uint32_t compute_record_checksum(const RecordHeader &header, const void *data) {
+			uint32_t crc = compute_header_crc(header);
+			if (header.type == RecordType::DATA) {
+				crc = util::crc32c(data, header.len, crc);
+			}
+			return finish_checksum(crc);
+		}
+
+	}
+
+	template<class NVMType = NVM>
+	class PersistentRedoLog {
+	private:
+		using RecordHeader = redo_log_detail::RecordHeader;
+		using RecordType   = redo_log_detail::RecordType;
+		using HeadSlot     = redo_log_detail::HeadSlot;
+		using SegmentHeader = redo_log_detail::SegmentHeader;
+
+		static constexpr size_t RECORD_HEADER_SIZE = sizeof(RecordHeader);
+
+		static constexpr size_t SEGMENT_HEADER_SIZE = sizeof(SegmentHeader);
+
+		/*!
+		 * @brief Volatile state of segment
+		 */
+		struct alignas(CACHE_LINE_SIZE) Segment {
+			SegmentHeader *header;
+			/// The start of ring buffer
+			uint8_t *ring_ptr;
+			/// Logical offset of the oldest record
+			uint64_t head;
+			uint64_t head_seq;
+			/// Logical offset where the next record is written
+			uint64_t tail;
+			uint64_t next_seq;
+			uint64_t generation;
+			uint32_t epoch;
+		};
+
+	private:
+		FileDescriptor &file_;
+
+		uint32_t num_segment_;
+
+		size_t segment_size_;
+		/// The size of ring buffer in each segment
+		size_t capacity_;
+
+		std::unique_ptr<Segment[]> segment_array_;
+		/// Serialize unregistered threads, which share the last segment
+		std::mutex shared_mutex_;
+
+	public:
+		/*!
+		 * @brief Format or recover the log in data area of file.
+		 * The log is recovered if the file was opened, which finds the tail of each segment.
+		 * @param file The mapped pool, which should be used only by the log
+		 * @param num_thread_segment The number of per-thread segments, to which one shared segment is added
+		 * @param num_recovery_worker_per_node The number of workers validating segments on each numa node, 0 for all cpus
+		 */
+		explicit PersistentRedoLog(FileDescriptor &file, uint32_t num_thread_segment = thread::MAX_TID,
+		                           int num_recovery_worker_per_node = 0):
+				file_(file), num_segment_(num_thread_segment + 1),
+				segment_size_(util_macro::align_floor(file.aligned_total_size / (num_thread_segment + 1), MEM_PAGE_SIZE)),
+				capacity_(segment_size_ - SEGMENT_HEADER_SIZE),
+				segment_array_(std::make_unique<Segment[]>(num_thread_segment + 1)) {
+
+			if (segment_size_ <= SEGMENT_HEADER_SIZE) {
+				util::logger_exception("The pool is too small for ", num_segment_, " log segments");
+			}
+
+			parallel_for_each_task(num_segment_, [&](size_t segment_id) {
+				Segment &segment = segment_array_[segment_id];
+				segment.header   = reinterpret_cast<SegmentHeader *>(file_.aligned_start_ptr + segment_id * segment_size_);
+				segment.ring_ptr = reinterpret_cast<uint8_t *>(segment.header) + SEGMENT_HEADER_SIZE;
+				recover_segment(segment);
+			}, num_recovery_worker_per_node);
+		}
+
+		PersistentRedoLog(const PersistentRedoLog &other) = delete;
+
+		~PersistentRedoLog() = default;
+
+	public:
+		/*!
+		 * @brief Append a record to the segment of the current thread without fence.
+		 * It becomes persistent after the next commit() of the same thread.
+		 * @param data The payload
+		 * @param len The length of payload
+		 * @param key A value kept with the record, e.g. commit timestamp
+		 * @return The lsn after the record, or 0 if the segment is full
+		 */
+		uint64_t append(const void *data, size_t len, uint64_t key = 0) {
+			uint32_t segment_id = get_current_segment();
+			if (segment_id == num_segment_ - 1) [[unlikely]] {
+				std::lock_guard<std::mutex> lock(shared_mutex_);
+				return append_to_segment(segment_array_[segment_id], data, len, key);
+			}
+			return append_to_segment(segment_array_[segment_id], data, len, key);
+		}
+
+		/*!
+		 * @brief Make all records appended by the current thread persistent, with one sfence
+		 */
+		void commit() {
+			drain_nt_store<NVMType>();
+		}
+
+		uint64_t append_commit(const void *data, size_t len, uint64_t key = 0) {
+			uint64_t lsn = append(data, len, key);
+			commit();
+			return lsn;
+		}
+
+		/*!
+		 * @brief Discard records of the current thread up to lsn, after they have been applied
+		 * @param lsn A value returned by append()
+		 */
+		void truncate(uint64_t lsn) {
+			uint32_t segment_id = get_current_segment();
+			if (segment_id == num_segment_ - 1) [[unlikely]] {
+				std::lock_guard<std::mutex> lock(shared_mutex_);
+				truncate_segment(segment_array_[segment_id], lsn);
+				return;
+			}
+			truncate_segment(segment_array_[segment_id], lsn);
+		}
+
+		/*!
+		 * @brief Discard all records of all segments, with no concurrent appender
+		 */
+		void clear() {
+			for (uint32_t segment_id = 0; segment_id < num_segment_; ++segment_id) {
+				Segment &segment = segment_array_[segment_id];
+				truncate_segment(segment, segment.tail);
+			}
+		}
+
+		/*!
+		 * @brief Visit live records of a segment in order, with no concurrent appender
+		 * @param func Called as func(const RedoRecord &)
+		 */
+		template<class Func>
+		void for_each_record(uint32_t segment_id, Func &&func) const {
+			const Segment &segment = segment_array_[segment_id];
+			uint64_t pos = segment.head;
+			uint64_t seq = segment.head_seq;
+			while (pos < segment.tail) {
+				const RecordHeader *header = get_record(segment, pos);
+				if (header->type == RecordType::DATA) {
+					uint64_t next_pos = pos + get_record_size(header->len);
+					const RedoRecord record{
+						segment_id, seq, header->key, next_pos,
+						reinterpret_cast<const uint8_t *>(header) + RECORD_HEADER_SIZE, header->len
+					};
+					func(record);
+					pos = next_pos;
+				}
+				else {
+					pos += capacity_ - get_ring_offset(pos);
+				}
+				++seq;
+			}
+		}
+
+		/*!
+		 * @brief Visit live records of all segments, segment by segment
+		 */
+		template<class Func>
+		void for_each_record(Func &&func) const {
+			for (uint32_t segment_id = 0; segment_id < num_segment_; ++segment_id) {
+				for_each_record(segment_id, func);
+			}
+		}
+
+		/*!
+		 * @brief Gather live records of all segments in parallel, ordered by key given to append().
+		 * Records with equal keys are ordered by segment and then by sequence number.
+		 * @param num_worker_per_node The number of workers on each numa node, 0 for all cpus
+		 */
+		[[nodiscard]] std::vector<RedoRecord> collect_records(int num_worker_per_node = 0) const {
+			return parallel_scan<RedoRecord>(num_segment_, [this](size_t segment_id, std::vector<RedoRecord> &result) {
+				for_each_record(static_cast<uint32_t>(segment_id), [&result](const RedoRecord &record) {
+					result.emplace_back(record);
+				});
+			}, [](const RedoRecord &record) { return record.key; }, num_worker_per_node);
+		}
+
+		[[nodiscard]] uint32_t get_num_segment() const {
+			return num_segment_;
+		}
+
+		/*!
+		 * @brief Get the max length of payload of one record
+		 */
+		[[nodiscard]] size_t get_max_record_size() const {
+			return capacity_ / 2 - RECORD_HEADER_SIZE;
+		}
+
+		/*!
+		 * @brief Get the space used by live records in segment
+		 */
+		[[nodiscard]] size_t get_used_size(uint32_t segment_id) const {
+			return segment_array_[segment_id].tail - segment_array_[segment_id].head;
+		}
+
+	private:
+		uint32_t get_current_segment() const {
+			uint32_t tid = thread::get_tid();
+			return tid < num_segment_ - 1 ? tid : num_segment_ - 1;
+		}
+
+		static constexpr size_t get_record_size(size_t len) {
+			return util_macro::align_ceil(RECORD_HEADER_SIZE + len, CACHE_LINE_SIZE);
+		}
+
+		[[nodiscard]] size_t get_ring_offset(uint64_t pos) const {
+			return pos % capacity_;
+		}
+
+		[[nodiscard]] RecordHeader *get_record(const Segment &segment, uint64_t pos) const {
+			return reinterpret_cast<RecordHeader *>(segment.ring_ptr + get_ring_offset(pos));
+		}
+
+		uint64_t append_to_segment(Segment &segment, const void *data, size_t len, uint64_t key) {
+			if (len > get_max_record_size()) [[unlikely]] {
+				return 0;
+			}
+
+			size_t record_size = get_record_size(len);
+			size_t ring_offset = get_ring_offset(segment.tail);
+			size_t wrap_size   = ring_offset + record_size > capacity_ ? capacity_ - ring_offset : 0;
+			if (segment.tail + wrap_size + record_size - segment.head > capacity_) {
+				return 0;
+			}
+
+			if (wrap_size != 0) {
+				write_record(segment, RecordType::WRAP, nullptr, wrap_size - RECORD_HEADER_SIZE, 0);
+				segment.tail += wrap_size;
+			}
+			write_record(segment, RecordType::DATA, static_cast<const uint8_t *>(data), len, key);
+			segment.tail += record_size;
+			return segment.tail;
+		}
+
+		/*!
+		 * @brief Write a record at tail by non-temporal stores of whole cache lines.
+		 * The first line (header with the beginning of payload) and the last partial line
+		 * are staged, so that the kernel never falls back to cached stores. The aligned body
+		 * is checksummed while it is copied, and the first line is written last with the checksum.
+		 */
+		void write_record(Segment &segment, RecordType type, const uint8_t *data, size_t len, uint64_t key) {
+			constexpr size_t FIRST_PAYLOAD_SIZE = CACHE_LINE_SIZE - RECORD_HEADER_SIZE;
+
+			uint8_t *dest = reinterpret_cast<uint8_t *>(get_record(segment, segment.tail));
+			alignas(CACHE_LINE_SIZE) uint8_t line[CACHE_LINE_SIZE]{};
+
+			RecordHeader header{ 0, segment.epoch, segment.next_seq++, key, static_cast<uint32_t>(len), type, 0 };
+			uint32_t crc = redo_log_detail::compute_header_crc(header);
+
+			size_t payload_len = type == RecordType::DATA ? len : 0;
+			size_t first_len   = std::min(payload_len, FIRST_PAYLOAD_SIZE);
+			if (first_len > 0) {
+				std::memcpy(line + RECORD_HEADER_SIZE, data, first_len);
+				crc = util::crc32c(data, first_len, crc);
+			}
+
+			if (payload_len > first_len) {
+				size_t rest_len = payload_len - first_len;
+				size_t body_len = util_macro::align_floor(rest_len, CACHE_LINE_SIZE);
+				if (body_len > 0) {
+					crc = memcpy_movnt_crc32c(dest + CACHE_LINE_SIZE, data + first_len, body_len, crc);
+				}
+				if (size_t tail_len = rest_len - body_len; tail_len > 0) {
+					alignas(CACHE_LINE_SIZE) uint8_t tail_line[CACHE_LINE_SIZE]{};
+					std::memcpy(tail_line, data + first_len + body_len, tail_len);
+					crc = util::crc32c(tail_line, tail_len, crc);
+					memcpy_movnt(dest + CACHE_LINE_SIZE + body_len, tail_line, CACHE_LINE_SIZE);
+				}
+			}
+
+			header.checksum = redo_log_detail::finish_checksum(crc);
+			std::memcpy(line, &header, RECORD_HEADER_SIZE);
+			memcpy_movnt(dest, line, CACHE_LINE_SIZE);
+			observe_nt_store<NVMType>(dest, get_record_size(payload_len));
+		}
+
+		void truncate_segment(Segment &segment, uint64_t lsn) {
+			assert(lsn >= segment.head && lsn <= segment.tail);
+
+			// Count records before lsn to get the sequence number of new head
+			uint64_t pos = segment.head;
+			uint64_t seq = segment.head_seq;
+			while (pos < lsn) {
+				const RecordHeader *header = get_record(segment, pos);
+				pos += header->type == RecordType::DATA ? get_record_size(header->len) : capacity_ - get_ring_offset(pos);
+				++seq;
+			}
+			assert(pos == lsn && "Truncate at the middle of record");
+
+			segment.head     = lsn;
+			segment.head_seq = seq;
+			persist_head(segment);
+		}
+
+		/*!
+		 * @brief Write the volatile head into the older slot
+		 */
+		void persist_head(Segment &segment) {
+			HeadSlot &slot  = segment.header->slot_array[++segment.generation % 2];
+			slot.head       = segment.head;
+			slot.head_seq   = segment.head_seq;
+			slot.generation = segment.generation;
+			slot.epoch      = segment.epoch;
+			slot.checksum   = slot.compute_checksum();
+			NVMType::pwb(&slot);
+			NVMType::fence();
+		}
+
+		/*!
+		 * @brief Find the head from slots and the tail by walking the chain, then start a new epoch.
+		 */
+		void recover_segment(Segment &segment) {
+			const HeadSlot *valid_slot = nullptr;
+			for (const HeadSlot &slot: segment.header->slot_array) {
+				if (slot.generation != 0 && slot.checksum == slot.compute_checksum() &&
+				    (valid_slot == nullptr || slot.generation > valid_slot->generation)) {
+					valid_slot = &slot;
+				}
+			}
+
+			if (valid_slot == nullptr) {
+				// Fresh segment
+				segment.head = segment.head_seq = segment.generation = 0;
+				segment.epoch = 0;
+			}
+			else {
+				segment.head       = valid_slot->head;
+				segment.head_seq   = valid_slot->head_seq;
+				segment.generation = valid_slot->generation;
+				segment.epoch      = static_cast<uint32_t>(valid_slot->epoch);
+			}
+
+			uint64_t pos = segment.head;
+			uint64_t seq = segment.head_seq;
+			uint32_t prev_epoch = 0;
+			while (pos + RECORD_HEADER_SIZE - segment.head <= capacity_) {
+				const RecordHeader *header = get_record(segment, pos);
+				size_t ring_offset = get_ring_offset(pos);
+				if (header->seq != seq || header->epoch < prev_epoch || header->epoch > segment.epoch ||
+				    header->len > capacity_ - ring_offset - RECORD_HEADER_SIZE) {
+					break;
+				}
+
+				const uint8_t *payload = reinterpret_cast<const uint8_t *>(header) + RECORD_HEADER_SIZE;
+				if (header->checksum != redo_log_detail::compute_record_checksum(*header, payload)) {
+					break;
+				}
+
+				uint64_t next_pos;
+				if (header->type == RecordType::DATA) {
+					next_pos = pos + get_record_size(header->len);
+				}
+				else if (header->type == RecordType::WRAP && header->len == capacity_ - ring_offset - RECORD_HEADER_SIZE) {
+					next_pos = pos + capacity_ - ring_offset;
+				}
+				else {
+					break;
+				}
+				if (next_pos - segment.head > capacity_) {
+					break;
+				}
+
+				pos = next_pos;
+				prev_epoch = header->epoch;
+				++seq;
+			}
+			segment.tail     = pos;
+			segment.next_seq = seq;
+
+			if (segment.epoch == std::numeric_limits<uint32_t>::max()) [[unlikely]] {
+				// Stale records of earlier epochs would be taken as newer ones after wrap
+				if (segment.tail != segment.head) {
+					util::logger_exception("Epoch of redo log segment would wrap with live records, "
+					                       "which should be applied and truncated before opening once more");
+				}
+				persist_memset<NVMType>(segment.ring_ptr, 0, capacity_);
+				segment.epoch = 0;
+			}
+
+			// Records written from now on are distinguishable from stale ones after the tail
+			++segment.epoch;
+			persist_head(segment);
+		}
+	};
+
+}
+
+#endif //UTIL_MEM_REDO_LOG_H
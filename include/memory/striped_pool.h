@@ -0,0 +1,240 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/4
+ */
+
+#pragma once
+#ifndef UTIL_MEM_STRIPED_POOL_H
+#define UTIL_MEM_STRIPED_POOL_H
+
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <arch/arch.h>
+#include <util/utility_macro.h>
+#include <thread/thread_numa.h>
+#include <memory/memory_config.h>
+#include <memory/mapping.h>
+#include <memory/file_descriptor.h>
+
+inline namespace util_mem {
+
+	/// The default size of stripes in the interleaved view
+	#ifndef STRIPED_POOL_STRIPE_SIZE_DEFINED
+		constexpr size_t STRIPED_POOL_STRIPE_SIZE = 4_KB;
+	#else
+		constexpr size_t STRIPED_POOL_STRIPE_SIZE = STRIPED_POOL_STRIPE_SIZE_DEFINED;
+	#endif
+
+	/*!
+	 * @brief A pool made of one file on each pmem directory in ARCH_PMEM_DIR_NAME (normally one per socket).
+	 * It provides two views:
+	 *  NUMA-local: each numa node allocates from the device attached to itself.
+	 *  Interleaved: a logical address space striped over all devices in round-robin.
+	 * Allocation by allocate_local() is a volatile bump pointer, which is not recovered after restart.
+	 */
+	class StripedPool {
+	private:
+		struct alignas(CACHE_LINE_SIZE) DeviceInfo {
+			std::unique_ptr<FileDescriptor> file;
+			/// The numa node owning the device
+			int numa_id;
+			/// Offset of the next allocation in data area
+			std::atomic<size_t> alloc_offset;
+		};
+
+	private:
+		std::vector<DeviceInfo> device_array_;
+		/// The device chosen by each numa node
+		std::vector<int> node_to_device_;
+
+		size_t stripe_size_;
+		/// The size of data area used by interleaved view on each device
+		size_t stripe_area_size_;
+
+	public:
+		/*!
+		 * @brief Create or open one file on each pmem directory in ARCH_PMEM_DIR_NAME.
+		 * @param file_name The name of file in each directory
+		 * @param size_per_device The size of file on each device
+		 * @param mode The way to get files
+		 * @param layout_id Identify the layout of data
+		 * @param stripe_size The size of stripes in interleaved view, power of 2
+		 * @param option Options of mapping
+		 */
+		StripedPool(std::string_view file_name, size_t size_per_device, FileMode mode = FileMode::CREATE,
+		            uint64_t layout_id = 0, size_t stripe_size = STRIPED_POOL_STRIPE_SIZE,
+		            const MapOption &option = MapOption()):
+				StripedPool(std::vector<std::string>(std::begin(PMEM_DIR_ARRAY), std::end(PMEM_DIR_ARRAY)),
+				            file_name, size_per_device, mode, layout_id, stripe_size, option) {
+
+			static_assert(std::size(PMEM_DIR_ARRAY) > 0, "ARCH_PMEM_DIR_NAME should contain at least one directory");
+		}
+
+		/*!
+		 * @brief Create or open one file on each given directory, e.g. directories of test.
+		 * @param dir_array Directories of devices, whose order decides the order of stripes
+		 */
+		StripedPool(const std::vector<std::string> &dir_array, std::string_view file_name, size_t size_per_device,
+		            FileMode mode = FileMode::CREATE, uint64_t layout_id = 0, size_t stripe_size = STRIPED_POOL_STRIPE_SIZE,
+		            const MapOption &option = MapOption()):
+				device_array_(dir_array.size()), stripe_size_(stripe_size), stripe_area_size_(0) {
+
+			if (dir_array.empty()) {
+				util::logger_exception("Striped pool should contain at least one directory");
+			}
+			if (!util_macro::is_2pow(stripe_size_)) {
+				util::logger_exception("Stripe size ", stripe_size_, " should be power of 2");
+			}
+
+			stripe_area_size_ = std::numeric_limits<size_t>::max();
+			for (size_t device_id = 0; device_id < device_array_.size(); ++device_id) {
+				auto &device = device_array_[device_id];
+				device.file    = std::make_unique<FileDescriptor>(dir_array[device_id], file_name, size_per_device, mode, layout_id, option);
+				device.numa_id = thread::NUMAConfig::get_node_of_file(device.file->file_path);
+				device.alloc_offset.store(0, std::memory_order::relaxed);
+
+				stripe_area_size_ = std::min<size_t>(stripe_area_size_, util_macro::floor_2pow(device.file->aligned_total_size, stripe_size_));
+			}
+
+			// Nodes without local device take devices in round-robin
+			node_to_device_.resize(thread::NUMAConfig::get_max_numa_node(), -1);
+			for (int device_id = static_cast<int>(device_array_.size()) - 1; device_id >= 0; --device_id) {
+				int numa_id = device_array_[device_id].numa_id;
+				if (numa_id < static_cast<int>(node_to_device_.size())) {
+					node_to_device_[numa_id] = device_id;
+				}
+			}
+			for (size_t numa_id = 0; numa_id < node_to_device_.size(); ++numa_id) {
+				if (node_to_device_[numa_id] < 0) {
+					node_to_device_[numa_id] = static_cast<int>(numa_id % device_array_.size());
+				}
+			}
+		}
+
+		StripedPool(const StripedPool &other) = delete;
+
+		~StripedPool() = default;
+
+	public:
+		[[nodiscard]] size_t get_num_device() const {
+			return device_array_.size();
+		}
+
+		[[nodiscard]] FileDescriptor &get_device(size_t device_id) {
+			return *device_array_[device_id].file;
+		}
+
+		[[nodiscard]] int get_device_node(size_t device_id) const {
+			return device_array_[device_id].numa_id;
+		}
+
+		/*!
+		 * @brief Whether any device was not closed normally, so that data should be recovered
+		 */
+		[[nodiscard]] bool needs_recovery() const {
+			for (auto &device: device_array_) {
+				if (device.file->needs_recovery()) { return true; }
+			}
+			return false;
+		}
+
+	public:
+		/*
+		 * NUMA-local view
+		 */
+
+		[[nodiscard]] size_t get_device_of_node(int numa_id) const {
+			return node_to_device_[numa_id % node_to_device_.size()];
+		}
+
+		/*!
+		 * @brief Get the device attached to the numa node running the current thread
+		 */
+		[[nodiscard]] FileDescriptor &get_local_device() {
+			return get_device(get_device_of_node(thread::NUMAConfig::get_node_of_current_cpu()));
+		}
+
+		/*!
+		 * @brief Allocate space from the device of specific numa node.
+		 * @param numa_id The id of numa node
+		 * @param size The size to allocate
+		 * @param align The alignment of result, power of 2
+		 * @return The allocated space, or nullptr if the device is full
+		 */
+		void *allocate_on_node(int numa_id, size_t size, size_t align = CACHE_LINE_SIZE) {
+			auto &device  = device_array_[get_device_of_node(numa_id)];
+			size_t offset = device.alloc_offset.load(std::memory_order::relaxed);
+			size_t begin;
+			do {
+				begin = util_macro::ceil_2pow(offset, align);
+				if (begin + size > device.file->aligned_total_size) {
+					return nullptr;
+				}
+			} while (!device.alloc_offset.compare_exchange_weak(offset, begin + size, std::memory_order::relaxed));
+			return device.file->aligned_start_ptr + begin;
+		}
+
+		/*!
+		 * @brief Allocate space from the device attached to the numa node running the current thread
+		 */
+		void *allocate_local(size_t size, size_t align = CACHE_LINE_SIZE) {
+			return allocate_on_node(thread::NUMAConfig::get_node_of_current_cpu(), size, align);
+		}
+
+	public:
+		/*
+		 * Interleaved view
+		 */
+
+		[[nodiscard]] size_t get_stripe_size() const {
+			return stripe_size_;
+		}
+
+		/*!
+		 * @brief Get the size of logical address space of interleaved view
+		 */
+		[[nodiscard]] size_t get_interleaved_size() const {
+			return stripe_area_size_ * device_array_.size();
+		}
+
+		/*!
+		 * @brief Translate the logical offset of interleaved view to address.
+		 * The address is valid until the end of its stripe.
+		 */
+		[[nodiscard]] uint8_t *get_interleaved_address(size_t offset) const {
+			size_t stripe_id     = offset / stripe_size_;
+			size_t device_id     = stripe_id % device_array_.size();
+			size_t device_offset = (stripe_id / device_array_.size()) * stripe_size_ + (offset & (stripe_size_ - 1));
+			return device_array_[device_id].file->aligned_start_ptr + device_offset;
+		}
+
+		/*!
+		 * @brief Split a logical range of interleaved view into contiguous segments.
+		 * @param offset The logical offset
+		 * @param len The length of range
+		 * @param func Called as func(uint8_t *segment, size_t segment_len, size_t logical_offset) for each segment
+		 */
+		template<class Func>
+		void for_each_interleaved_segment(size_t offset, size_t len, Func &&func) const {
+			while (len > 0) {
+				size_t segment_len = std::min(len, stripe_size_ - (offset & (stripe_size_ - 1)));
+				func(get_interleaved_address(offset), segment_len, offset);
+				offset += segment_len;
+				len    -= segment_len;
+			}
+		}
+
+	private:
+		static constexpr const char *PMEM_DIR_ARRAY[] = ARCH_PMEM_DIR_NAME;
+	};
+
+}
+
+#endif //UTIL_MEM_STRIPED_POOL_H
@@ -0,0 +1,365 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/11
+ */
+
+#pragma once
+#ifndef UTIL_MEM_UNDO_LOG_H
+#define UTIL_MEM_UNDO_LOG_H
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <type_traits>
+
+#include <logger/logger.h>
+#include <util/utility_macro.h>
+#include <util/crc32c.h>
+#include <thread/thread.h>
+#include <thread/thread_numa.h>
+#include <thread/thread_worker.h>
+#include <memory/memory_config.h>
+#include <memory/nvm_config.h>
+#include <memory/file_descriptor.h>
+
+/*
+ * Undo log for in-place updates of persistent data, with the granularity of cache line.
+ *
+ * Before the first store to a line in a transaction, the content of line is copied into the log
+ * area of the thread and persisted by pwb and fence. Lines already logged in the transaction are
+ * filtered out in DRAM, so repeated stores to the same line cost nothing. At commit, modified lines
+ * are flushed, and then the transaction is marked finished in the area header.
+ *
+ * After a crash, areas of unfinished transactions are rolled back in parallel. An entry is valid
+ * only if it carries the id of the unfinished transaction and a correct checksum, which excludes
+ * stale entries of earlier transactions and the entry torn by the crash.
+ *
+ * The log and the data should be in different files. Entries refer to lines by offset in the data file.
+ */
+
+inline namespace util_mem {
+
+	namespace undo_log_detail {
+
+		/*!
+		 * @brief Persistent header of the log area of one thread
+		 */
+		struct alignas(CACHE_LINE_SIZE) AreaHeader {
+			/// The id of the last transaction shifted by 1, with the lowest bit set if it is unfinished.
+			/// Entries of the next transaction may be persisted before the state, so that ids are never reused.
+			std::atomic<uint64_t> state;
+		};
+
+		struct alignas(CACHE_LINE_SIZE) UndoEntry {
+			uint64_t tx_id;
+			/// Offset of line in data file
+			uint64_t offset;
+			/// CRC32C of fields above and data
+			uint64_t checksum;
+			/// The content of line before modification
+			alignas(CACHE_LINE_SIZE) uint8_t data[CACHE_LINE_SIZE];
+
+			[[nodiscard]] uint64_t compute_checksum() const {
+				uint32_t crc = util::crc32c(this, offsetof(UndoEntry, checksum));
+				return util::crc32c(data, CACHE_LINE_SIZE, crc);
+			}
+		};
+
+		static_assert(sizeof(UndoEntry) == 2 * CACHE_LINE_SIZE);
+
+		/*!
+		 * @brief A slot of dedup filter, which is empty unless tagged by the current transaction
+		 */
+		struct DedupSlot {
+			uintptr_t line;
+			uint64_t tx_id;
+		};
+
+	}
+
+	template<class NVMType = NVM>
+	class PersistentUndoLog {
+	private:
+		using AreaHeader = undo_log_detail::AreaHeader;
+		using UndoEntry  = undo_log_detail::UndoEntry;
+		using DedupSlot  = undo_log_detail::DedupSlot;
+
+		/*!
+		 * @brief Volatile state of the area of one thread
+		 */
+		struct alignas(CACHE_LINE_SIZE) ThreadLog {
+			AreaHeader *header;
+
+			UndoEntry *entry_array;
+			/// The number of entries in the current transaction
+			uint32_t num_entry;
+
+			uint64_t tx_id;
+			/// Whether the current transaction has been marked unfinished persistently
+			bool active;
+
+			std::unique_ptr<DedupSlot[]> filter;
+		};
+
+	private:
+		FileDescriptor &log_file_;
+
+		FileDescriptor &data_file_;
+
+		uint32_t num_area_;
+		/// The max number of entries in one transaction
+		uint32_t capacity_;
+
+		uint32_t filter_mask_;
+
+		std::unique_ptr<ThreadLog[]> log_array_;
+
+	public:
+		/*!
+		 * @brief Divide the data area of log file into per-thread areas, and roll back unfinished transactions.
+		 * @param log_file The pool holding the log, which should be used only by the log
+		 * @param data_file The pool holding data modified in place
+		 * @param num_recovery_thread The number of workers rolling back areas
+		 * @param num_area The number of per-thread areas, no less than the number of registered threads
+		 */
+		PersistentUndoLog(FileDescriptor &log_file, FileDescriptor &data_file,
+		                  int num_recovery_thread = 1, uint32_t num_area = thread::MAX_TID):
+				log_file_(log_file), data_file_(data_file), num_area_(num_area), capacity_(0), filter_mask_(0),
+				log_array_(std::make_unique<ThreadLog[]>(num_area)) {
+
+			size_t area_size = util_macro::align_floor(log_file_.aligned_total_size / num_area_, MEM_PAGE_SIZE);
+			if (area_size <= sizeof(AreaHeader)) {
+				util::logger_exception("The pool is too small for ", num_area_, " undo log areas");
+			}
+			capacity_    = (area_size - sizeof(AreaHeader)) / sizeof(UndoEntry);
+			filter_mask_ = std::bit_ceil(2 * capacity_) - 1;
+
+			for (uint32_t area_id = 0; area_id < num_area_; ++area_id) {
+				ThreadLog &log   = log_array_[area_id];
+				uint8_t *area    = log_file_.aligned_start_ptr + area_id * area_size;
+				log.header       = reinterpret_cast<AreaHeader *>(area);
+				log.entry_array  = reinterpret_cast<UndoEntry *>(area + sizeof(AreaHeader));
+				log.num_entry    = 0;
+				log.tx_id        = 0;
+				log.active       = false;
+			}
+
+			recover(num_recovery_thread);
+		}
+
+		PersistentUndoLog(const PersistentUndoLog &other) = delete;
+
+		~PersistentUndoLog() = default;
+
+	public:
+		/*!
+		 * @brief Start a transaction of the current thread. Nothing is persisted until the first log().
+		 */
+		void begin() {
+			ThreadLog &log = get_thread_log();
+			assert(!log.active && log.num_entry == 0 && "Nested transaction is not supported");
+			if (!log.filter) [[unlikely]] {
+				log.filter = std::make_unique<DedupSlot[]>(filter_mask_ + 1);
+			}
+		}
+
+		/*!
+		 * @brief Snapshot lines covering the range before it is modified, with one fence for all new lines.
+		 * The range should lie in the data file.
+		 * @return False if the transaction exceeds the capacity of log, in which case it should be aborted.
+		 * Lines logged before the overflow still belong to the transaction, which is marked unfinished.
+		 */
+		bool log(const void *addr, size_t size) {
+			ThreadLog &log = get_thread_log();
+			uintptr_t line_begin = util_macro::align_floor(reinterpret_cast<uintptr_t>(addr), CACHE_LINE_SIZE);
+			uintptr_t line_end   = reinterpret_cast<uintptr_t>(addr) + size;
+			// Entries refer to lines by offset, which recovery drops if it is out of data file
+			assert(line_begin >= reinterpret_cast<uintptr_t>(data_file_.start_ptr) &&
+			       line_end <= reinterpret_cast<uintptr_t>(data_file_.start_ptr) + data_file_.total_size &&
+			       "Logged range should lie in data file");
+
+			bool res        = true;
+			bool need_fence = false;
+			for (uintptr_t line = line_begin; line < line_end; line += CACHE_LINE_SIZE) {
+				DedupSlot *slot = find_slot(log, line);
+				if (slot->tx_id == log.tx_id) {
+					continue;
+				}
+				if (log.num_entry == capacity_) [[unlikely]] {
+					res = false;
+					break;
+				}
+				slot->line  = line;
+				slot->tx_id = log.tx_id;
+
+				UndoEntry &entry = log.entry_array[log.num_entry++];
+				std::memcpy(entry.data, reinterpret_cast<const void *>(line), CACHE_LINE_SIZE);
+				entry.tx_id    = log.tx_id;
+				entry.offset   = line - reinterpret_cast<uintptr_t>(data_file_.start_ptr);
+				entry.checksum = entry.compute_checksum();
+				NVMType::pwb_range(&entry, sizeof(UndoEntry));
+				need_fence = true;
+			}
+
+			if (need_fence) {
+				if (!log.active) {
+					// Persisted by the same fence as the first entries
+					log.header->state.store((log.tx_id << 1) | 1, std::memory_order::relaxed);
+					NVMType::pwb(log.header);
+					log.active = true;
+				}
+				NVMType::fence();
+			}
+			return res;
+		}
+
+		/*!
+		 * @brief Log and store a value in place. The store is persisted at commit.
+		 */
+		template<class T>
+		bool store(T *addr, const T &value) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			if (!log(addr, sizeof(T))) {
+				return false;
+			}
+			*addr = value;
+			return true;
+		}
+
+		/*!
+		 * @brief Persist modified lines and finish the transaction
+		 */
+		void commit() {
+			ThreadLog &log = get_thread_log();
+			assert((log.active || log.num_entry == 0) && "Logged lines should belong to an unfinished transaction");
+			if (log.active) {
+				for (uint32_t i = 0; i < log.num_entry; ++i) {
+					NVMType::pwb(get_data_line(log.entry_array[i].offset));
+				}
+				NVMType::fence();
+				finish(log);
+			}
+			log.num_entry = 0;
+		}
+
+		/*!
+		 * @brief Restore modified lines and finish the transaction
+		 */
+		void abort() {
+			ThreadLog &log = get_thread_log();
+			assert((log.active || log.num_entry == 0) && "Logged lines should belong to an unfinished transaction");
+			if (log.active) {
+				rollback_entries(log.entry_array, log.num_entry);
+				finish(log);
+			}
+			log.num_entry = 0;
+		}
+
+		/*!
+		 * @brief Get the max number of lines modified by one transaction
+		 */
+		[[nodiscard]] uint32_t get_capacity() const {
+			return capacity_;
+		}
+
+		[[nodiscard]] uint32_t get_num_logged_line() {
+			return get_thread_log().num_entry;
+		}
+
+	private:
+		ThreadLog &get_thread_log() {
+			uint32_t tid = thread::get_tid();
+			if (tid >= num_area_) [[unlikely]] {
+				util::logger_exception("Thread ", tid, " has no undo log area, which should be registered");
+			}
+			return log_array_[tid];
+		}
+
+		uint8_t *get_data_line(uint64_t offset) const {
+			return data_file_.start_ptr + offset;
+		}
+
+		DedupSlot *find_slot(ThreadLog &log, uintptr_t line) const {
+			uint32_t index = static_cast<uint32_t>(((line >> 6) * 0x9E3779B97F4A7C15ULL) >> 32) & filter_mask_;
+			while (true) {
+				DedupSlot *slot = &log.filter[index];
+				if (slot->tx_id != log.tx_id || slot->line == line) {
+					return slot;
+				}
+				index = (index + 1) & filter_mask_;
+			}
+		}
+
+		void finish(ThreadLog &log) {
+			log.header->state.store(log.tx_id << 1, std::memory_order::relaxed);
+			NVMType::pwb(log.header);
+			NVMType::fence();
+			// Read-only transactions keep the id, as they leave nothing in the log
+			++log.tx_id;
+			log.active = false;
+		}
+
+		/*!
+		 * @brief Copy snapshots back in reverse order and persist them
+		 */
+		void rollback_entries(const UndoEntry *entry_array, uint32_t num_entry) {
+			for (uint32_t i = num_entry; i-- > 0;) {
+				uint8_t *line = get_data_line(entry_array[i].offset);
+				std::memcpy(line, entry_array[i].data, CACHE_LINE_SIZE);
+				NVMType::pwb(line);
+			}
+			NVMType::fence();
+		}
+
+		/*!
+		 * @brief Roll back unfinished transactions, with areas distributed among workers
+		 * on the numa node of data file. Each worker fences its own flushes.
+		 * Every area then skips one transaction id, as entries of the transaction in flight
+		 * may have been persisted without its state.
+		 */
+		void recover(int num_thread) {
+			num_thread = std::max(1, std::min<int>(num_thread, num_area_));
+
+			auto rollback_area = [&](int worker_id) {
+				for (uint32_t area_id = worker_id; area_id < num_area_; area_id += num_thread) {
+					ThreadLog &log = log_array_[area_id];
+					uint64_t state = log.header->state.load(std::memory_order::relaxed);
+					log.tx_id = state >> 1;
+
+					if ((state & 1) != 0) {
+						uint32_t num_entry = 0;
+						while (num_entry < capacity_) {
+							const UndoEntry &entry = log.entry_array[num_entry];
+							if (entry.tx_id != log.tx_id || entry.checksum != entry.compute_checksum() ||
+							    entry.offset + CACHE_LINE_SIZE > data_file_.total_size) {
+								break;
+							}
+							++num_entry;
+						}
+						rollback_entries(log.entry_array, num_entry);
+					}
+
+					++log.tx_id;
+					log.header->state.store(log.tx_id << 1, std::memory_order::relaxed);
+					NVMType::pwb(log.header);
+					++log.tx_id;
+				}
+				NVMType::fence();
+			};
+
+			if (num_thread == 1) {
+				rollback_area(0);
+			}
+			else {
+				thread::run_workers_on_node(thread::NUMAConfig::get_node_of_file(data_file_.file_path), num_thread, rollback_area);
+			}
+		}
+	};
+
+}
+
+#endif //UTIL_MEM_UNDO_LOG_H
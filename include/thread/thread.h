@@ -164,7 +164,7 @@ namespace thread {
 		}
 	};
 
-	inline static ThreadConfig THREAD_CONFIG;
+	inline ThreadConfig THREAD_CONFIG;
 
 	class ThreadInfo {
 	private:
@@ -225,7 +225,9 @@ namespace thread {
 
 		int bind_cpu_on_node(int numa_id) {
 			int cpu_id = THREAD_CONFIG.allocate_cpu_on_node(tid_, numa_id);
-			ThreadConfig::bind_cpu(cpu_id);
+			if (cpu_id != ThreadConfig::INVALID_CPUID) {
+				ThreadConfig::bind_cpu(cpu_id);
+			}
 			return cpu_id;
 		}
 
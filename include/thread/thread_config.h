@@ -21,7 +21,7 @@ namespace thread {
 	/*!
 	 * @brief Pause to prevent excess processor bus usage
 	 */
-	void pause() {
+	inline void pause() {
 		#if defined( __sparc )
 			__asm__ __volatile__ ( "rd %ccr,%g0" );
 		#elif defined( __i386 ) || defined( __x86_64 )
@@ -9,7 +9,14 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <string>
+#include <fstream>
+#include <filesystem>
 #include <numa.h>
+#include <numaif.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 
 #include <arch/arch.h>
 #include <logger/logger.h>
@@ -92,9 +99,63 @@ namespace thread {
 			return {node_id};
 		}
 
+		/*!
+		 * @brief Acquire the numa node which owns the page of specific address.
+		 * @param addr The address to be detected
+		 * @return The id of numa node, or 0 if the node cannot be told.
+		 */
+		static int get_node_of_address(const void *addr) {
+			int node_id = -1;
+			if (get_mempolicy(&node_id, nullptr, 0, const_cast<void *>(addr), MPOL_F_NODE | MPOL_F_ADDR) < 0 || node_id < 0) {
+				return 0;
+			}
+			return node_id;
+		}
+
+		/*!
+		 * @brief Acquire the numa node of the cpu running the current thread.
+		 * @return The id of numa node, or 0 if the node cannot be told.
+		 */
+		static int get_node_of_current_cpu() {
+			int cpu_id = sched_getcpu();
+			int node_id = cpu_id < 0 ? -1 : numa_node_of_cpu(cpu_id);
+			return node_id < 0 ? 0 : node_id;
+		}
+
+		/*!
+		 * @brief Acquire the numa node which owns the device backing specific file.
+		 * The node is read from sysfs of the block device (e.g. /dev/pmem0), otherwise
+		 * the index of matched directory in ARCH_PMEM_DIR_NAME is regarded as the node.
+		 * @param path The path of file
+		 * @return The id of numa node, or 0 if the node cannot be told.
+		 */
+		static int get_node_of_file(const std::filesystem::path &path) {
+			struct stat file_stat{};
+			if (stat(path.c_str(), &file_stat) == 0) {
+				std::string dev_dir = "/sys/dev/block/" + std::to_string(major(file_stat.st_dev)) + ':' + std::to_string(minor(file_stat.st_dev));
+				// The latter is for partitions of device
+				for (const char *node_file: { "/device/numa_node", "/../device/numa_node" }) {
+					std::ifstream node_stream(dev_dir + node_file);
+					int node_id = -1;
+					if (node_stream >> node_id && node_id >= 0) {
+						return node_id;
+					}
+				}
+			}
+
+			const char *pmem_dir_array[] = ARCH_PMEM_DIR_NAME;
+			std::string path_str = std::filesystem::absolute(path).lexically_normal().string();
+			for (int node_id = 0; node_id < static_cast<int>(std::size(pmem_dir_array)) && node_id < NUMA_NODE_NUM; ++node_id) {
+				if (path_str.starts_with(pmem_dir_array[node_id])) {
+					return node_id;
+				}
+			}
+			return 0;
+		}
+
 	private:
 		static bool numa_available_warn() {
-			if (!numa_available()) {
+			if (numa_available() < 0) {
 				util::logger::logger_warn(
 						"NUMA is not available in this system. Binding node may incur undefined results."
 				);
@@ -105,7 +166,7 @@ namespace thread {
 
 	};
 
-	inline static NUMAConfig NUMA_CONFIG;
+	inline NUMAConfig NUMA_CONFIG;
 
 }
 
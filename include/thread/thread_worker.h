@@ -0,0 +1,94 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/6/26
+ */
+
+#pragma once
+#ifndef UTIL_THREAD_THREAD_WORKER_H
+#define UTIL_THREAD_THREAD_WORKER_H
+
+#include <thread>
+#include <vector>
+
+#include <thread/thread.h>
+#include <thread/thread_numa.h>
+
+namespace thread {
+
+	/*!
+	 * @brief Register the current thread and bind it to a free cpu on specific numa node.
+	 * If no tid or cpu is left, the thread is only bound to the node.
+	 * @param numa_id The id of numa node
+	 */
+	inline void bind_worker_on_node(int numa_id) {
+		if (THREAD_CONTEXT.allocate_tid() != ThreadConfig::INVALID_TID &&
+		    THREAD_CONTEXT.bind_cpu_on_node(numa_id) != ThreadConfig::INVALID_CPUID) {
+			return;
+		}
+		NUMAConfig::bind_node(numa_id);
+	}
+
+	/*!
+	 * @brief Run a group of workers on specific numa node and wait for all of them.
+	 * Each worker is registered and bound by bind_worker_on_node(),
+	 * and resources are released as the worker exits.
+	 * @param numa_id The id of numa node
+	 * @param num_worker The number of workers
+	 * @param func The task, which is called as func(worker_id)
+	 */
+	template<class Func>
+	inline void run_workers_on_node(int numa_id, int num_worker, Func &&func) {
+		std::vector<std::thread> worker_array;
+		worker_array.reserve(num_worker);
+
+		for (int worker_id = 0; worker_id < num_worker; ++worker_id) {
+			worker_array.emplace_back([&func, numa_id, worker_id]() {
+				bind_worker_on_node(numa_id);
+				func(worker_id);
+			});
+		}
+		for (auto &worker: worker_array) {
+			worker.join();
+		}
+	}
+
+	/*!
+	 * @brief Run workers on all numa nodes with cpus and wait for all of them.
+	 * Workers are registered and bound as in run_workers_on_node().
+	 * @param num_worker_per_node The number of workers on each node, or 0 for all cpus of the node in THREAD_CONFIG
+	 * @param max_num_worker The max number of workers in total, which are spread over nodes in round-robin
+	 * @param func The task, which is called as func(worker_id, numa_id)
+	 */
+	template<class Func>
+	inline void run_workers_on_all_nodes(int num_worker_per_node, int max_num_worker, Func &&func) {
+		std::vector<int> worker_node_array;
+		for (int round = 0; static_cast<int>(worker_node_array.size()) < max_num_worker; ++round) {
+			size_t old_num_worker = worker_node_array.size();
+			for (int numa_id = 0; numa_id < get_num_nodes() && static_cast<int>(worker_node_array.size()) < max_num_worker; ++numa_id) {
+				int num_worker = num_worker_per_node > 0 ? num_worker_per_node : THREAD_CONFIG.get_num_cpu_on_node(numa_id);
+				// Memory-only nodes get no worker
+				if (round < num_worker && THREAD_CONFIG.get_num_cpu_on_node(numa_id) > 0) {
+					worker_node_array.emplace_back(numa_id);
+				}
+			}
+			if (worker_node_array.size() == old_num_worker) {
+				break;
+			}
+		}
+
+		std::vector<std::thread> worker_array;
+		worker_array.reserve(worker_node_array.size());
+		for (int worker_id = 0; worker_id < static_cast<int>(worker_node_array.size()); ++worker_id) {
+			worker_array.emplace_back([&func, numa_id = worker_node_array[worker_id], worker_id]() {
+				bind_worker_on_node(numa_id);
+				func(worker_id, numa_id);
+			});
+		}
+		for (auto &worker: worker_array) {
+			worker.join();
+		}
+	}
+
+}
+
+#endif //UTIL_THREAD_THREAD_WORKER_H
@@ -0,0 +1,48 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/14
+ */
+
+#pragma once
+#ifndef UTIL_ATOMIC128_H
+#define UTIL_ATOMIC128_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace util {
+
+	/*!
+	 * @brief Compare and swap 16 bytes atomically by cmpxchg16b, e.g. a pointer with its version.
+	 * The instruction is encoded by inline assembly, so that no -mcx16 is required.
+	 * @param addr[in] The destination, aligned to 16 bytes
+	 * @param expected[in,out] The expected value, updated with the current value on failure
+	 * @param desired[in] The new value
+	 * @return Whether the swap succeeds
+	 */
+	template<class T>
+	inline bool cas128(T *addr, T &expected, const T &desired) {
+		static_assert(std::is_trivially_copyable_v<T> && sizeof(T) == 16, "cmpxchg16b works on 16-byte values");
+		static_assert(alignof(T) >= 16, "Type should be aligned to 16 bytes, as required by cmpxchg16b");
+
+		uint64_t expected_word[2], desired_word[2];
+		std::memcpy(expected_word, &expected, 16);
+		std::memcpy(desired_word, &desired, 16);
+
+		bool res;
+		asm volatile("lock cmpxchg16b %1"
+			: "=@ccz"(res), "+m"(*reinterpret_cast<unsigned __int128 *>(addr)),
+			  "+a"(expected_word[0]), "+d"(expected_word[1])
+			: "b"(desired_word[0]), "c"(desired_word[1])
+			: "memory");
+
+		if (!res) {
+			std::memcpy(&expected, expected_word, 16);
+		}
+		return res;
+	}
+
+}
+
+#endif //UTIL_ATOMIC128_H
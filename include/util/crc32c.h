@@ -0,0 +1,245 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/13
+ * @ref: https://github.com/madler/zlib/blob/master/crc32.c (GF(2) shift by multiplication modulo polynomial)
+ */
+
+#pragma once
+#ifndef UTIL_CRC32C_H
+#define UTIL_CRC32C_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <array>
+#include <immintrin.h>
+
+#include <arch/cpu_feature.h>
+
+/*
+ * CRC32C (Castagnoli), which has the instruction crc32 since SSE4.2.
+ *
+ * The instruction has a latency of 3 cycles but a throughput of 1 per cycle, so large buffers are
+ * split into 3 blocks processed as independent streams, whose results are combined by shifting
+ * CRC in GF(2): shifting the state by n zero bytes is multiplication by x^(8n) modulo the polynomial.
+ * The multiplication takes one pclmulqdq and one crc32 instruction, which is cheap enough for
+ * blocks of 256 bytes. CPUs without SSE4.2 or PCLMULQDQ use a slicing-by-8 table.
+ *
+ * crc32c(data, len, crc) returns the final CRC, and continues from a previous result given as crc,
+ * so that crc32c(b, len_b, crc32c(a, len_a)) equals the CRC of a followed by b.
+ */
+
+namespace util {
+
+	namespace crc32c_detail {
+
+		/// Reflected polynomial
+		inline constexpr uint32_t POLY = 0x82F63B78;
+
+		/*!
+		 * @brief Multiply a and b modulo the polynomial, in reflected representation
+		 */
+		inline constexpr uint32_t multmodp(uint32_t a, uint32_t b) {
+			uint32_t m = 1U << 31, p = 0;
+			while (true) {
+				if (a & m) {
+					p ^= b;
+					if ((a & (m - 1)) == 0) { break; }
+				}
+				m >>= 1;
+				b = (b & 1) ? (b >> 1) ^ POLY : b >> 1;
+			}
+			return p;
+		}
+
+		/*!
+		 * @brief Get x^k modulo the polynomial
+		 */
+		inline constexpr uint32_t get_power(size_t k) {
+			// x^0, and x^(2^i) from x^1 by repeated squaring
+			uint32_t x2i = 1U << 30;
+			uint32_t res = 1U << 31;
+			for (; k != 0; k >>= 1) {
+				if (k & 1) {
+					res = multmodp(x2i, res);
+				}
+				x2i = multmodp(x2i, x2i);
+			}
+			return res;
+		}
+
+		/*!
+		 * @brief Get x^(8n) modulo the polynomial
+		 */
+		inline constexpr uint32_t get_shift_operator(size_t n) {
+			return get_power(8 * n);
+		}
+
+		/*!
+		 * @brief Get the operator of shift_clmul() to shift by n zero bytes, which is x^(8n-33):
+		 * the carry-less product of reflected values carries an extra x, and crc32 multiplies by x^32.
+		 */
+		inline constexpr uint32_t get_clmul_shift_operator(size_t n) {
+			return get_power(8 * n - 33);
+		}
+
+		/*!
+		 * @brief Shift the state of CRC by n zero bytes
+		 */
+		inline constexpr uint32_t shift(uint32_t crc, size_t n) {
+			return multmodp(get_shift_operator(n), crc);
+		}
+
+		inline constexpr std::array<std::array<uint32_t, 256>, 8> make_table() {
+			std::array<std::array<uint32_t, 256>, 8> table{};
+			for (uint32_t i = 0; i < 256; ++i) {
+				uint32_t crc = i;
+				for (int k = 0; k < 8; ++k) {
+					crc = (crc & 1) ? (crc >> 1) ^ POLY : crc >> 1;
+				}
+				table[0][i] = crc;
+			}
+			for (uint32_t i = 0; i < 256; ++i) {
+				for (int k = 1; k < 8; ++k) {
+					table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+				}
+			}
+			return table;
+		}
+
+		inline constexpr auto TABLE = make_table();
+
+		/// Sizes of blocks of 3-way interleave, each with precomputed shift operators
+		inline constexpr size_t LONG_BLOCK  = 8192;
+		inline constexpr size_t SHORT_BLOCK = 256;
+
+		inline constexpr uint32_t LONG_SHIFT_1  = get_clmul_shift_operator(LONG_BLOCK);
+		inline constexpr uint32_t LONG_SHIFT_2  = get_clmul_shift_operator(2 * LONG_BLOCK);
+		inline constexpr uint32_t SHORT_SHIFT_1 = get_clmul_shift_operator(SHORT_BLOCK);
+		inline constexpr uint32_t SHORT_SHIFT_2 = get_clmul_shift_operator(2 * SHORT_BLOCK);
+
+		/*!
+		 * @brief Update the state with slicing-by-8
+		 */
+		inline uint32_t update_sw(uint32_t state, const uint8_t *ptr, size_t len) {
+			for (; len > 0 && (reinterpret_cast<uintptr_t>(ptr) & 7) != 0; --len, ++ptr) {
+				state = (state >> 8) ^ TABLE[0][(state ^ *ptr) & 0xFF];
+			}
+			for (; len >= 8; len -= 8, ptr += 8) {
+				uint64_t word;
+				std::memcpy(&word, ptr, sizeof(uint64_t));
+				word ^= state;
+				state = TABLE[7][word & 0xFF] ^ TABLE[6][(word >> 8) & 0xFF] ^
+				        TABLE[5][(word >> 16) & 0xFF] ^ TABLE[4][(word >> 24) & 0xFF] ^
+				        TABLE[3][(word >> 32) & 0xFF] ^ TABLE[2][(word >> 40) & 0xFF] ^
+				        TABLE[1][(word >> 48) & 0xFF] ^ TABLE[0][word >> 56];
+			}
+			for (; len > 0; --len, ++ptr) {
+				state = (state >> 8) ^ TABLE[0][(state ^ *ptr) & 0xFF];
+			}
+			return state;
+		}
+
+		__attribute__((target("sse4.2")))
+		static inline uint32_t update_hw_serial(uint32_t state, const uint8_t *ptr, size_t len) {
+			uint64_t state64 = state;
+			for (; len >= 8; len -= 8, ptr += 8) {
+				uint64_t word;
+				std::memcpy(&word, ptr, sizeof(uint64_t));
+				state64 = _mm_crc32_u64(state64, word);
+			}
+			state = static_cast<uint32_t>(state64);
+			for (; len > 0; --len, ++ptr) {
+				state = _mm_crc32_u8(state, *ptr);
+			}
+			return state;
+		}
+
+		/*!
+		 * @brief Shift the state of CRC by n zero bytes, with the operator given by get_clmul_shift_operator(n)
+		 */
+		__attribute__((target("sse4.2,pclmul")))
+		static inline uint32_t shift_clmul(uint32_t state, uint32_t clmul_operator) {
+			__m128i product = _mm_clmulepi64_si128(_mm_cvtsi32_si128(static_cast<int>(state)),
+			                                       _mm_cvtsi32_si128(static_cast<int>(clmul_operator)), 0x00);
+			return static_cast<uint32_t>(_mm_crc32_u64(0, static_cast<uint64_t>(_mm_cvtsi128_si64(product))));
+		}
+
+		/*!
+		 * @brief Process rounds of 3 blocks with independent streams, and combine them
+		 */
+		__attribute__((target("sse4.2,pclmul")))
+		static inline uint32_t update_hw_interleave(uint32_t state, const uint8_t *&ptr, size_t &len,
+		                                            size_t block, uint32_t shift_1, uint32_t shift_2) {
+			while (len >= 3 * block) {
+				uint64_t state0 = state, state1 = 0, state2 = 0;
+				for (size_t i = 0; i < block; i += 8) {
+					uint64_t word0, word1, word2;
+					std::memcpy(&word0, ptr + i, sizeof(uint64_t));
+					std::memcpy(&word1, ptr + block + i, sizeof(uint64_t));
+					std::memcpy(&word2, ptr + 2 * block + i, sizeof(uint64_t));
+					state0 = _mm_crc32_u64(state0, word0);
+					state1 = _mm_crc32_u64(state1, word1);
+					state2 = _mm_crc32_u64(state2, word2);
+				}
+				state = shift_clmul(static_cast<uint32_t>(state0), shift_2) ^
+				        shift_clmul(static_cast<uint32_t>(state1), shift_1) ^ static_cast<uint32_t>(state2);
+				ptr += 3 * block;
+				len -= 3 * block;
+			}
+			return state;
+		}
+
+		__attribute__((target("sse4.2,pclmul")))
+		static inline uint32_t update_hw(uint32_t state, const uint8_t *ptr, size_t len) {
+			state = update_hw_interleave(state, ptr, len, LONG_BLOCK, LONG_SHIFT_1, LONG_SHIFT_2);
+			state = update_hw_interleave(state, ptr, len, SHORT_BLOCK, SHORT_SHIFT_1, SHORT_SHIFT_2);
+			return update_hw_serial(state, ptr, len);
+		}
+
+	}
+
+	/*!
+	 * @brief CRC32C with the slicing-by-8 table
+	 * @param data[in] Data to process
+	 * @param len[in] The length of data
+	 * @param crc[in] CRC of preceding data, to process data in pieces
+	 * @return CRC of given data
+	 */
+	inline uint32_t crc32c_sw(const void *data, size_t len, uint32_t crc = 0) {
+		return ~crc32c_detail::update_sw(~crc, static_cast<const uint8_t *>(data), len);
+	}
+
+	/*!
+	 * @brief CRC32C with SSE4.2 and PCLMULQDQ, which should be supported by the running cpu
+	 */
+	__attribute__((target("sse4.2,pclmul")))
+	inline uint32_t crc32c_hw(const void *data, size_t len, uint32_t crc = 0) {
+		return ~crc32c_detail::update_hw(~crc, static_cast<const uint8_t *>(data), len);
+	}
+
+	/*!
+	 * @brief CRC32C with the fastest implementation on the running cpu
+	 * @param data[in] Data to process
+	 * @param len[in] The length of data
+	 * @param crc[in] CRC of preceding data, to process data in pieces
+	 * @return CRC of given data
+	 */
+	inline uint32_t crc32c(const void *data, size_t len, uint32_t crc = 0) {
+		static const bool use_hw = get_cpu_feature().sse4_2 && get_cpu_feature().pclmul;
+		return use_hw ? crc32c_hw(data, len, crc) : crc32c_sw(data, len, crc);
+	}
+
+	/*!
+	 * @brief Get CRC of concatenated data from CRC of both parts
+	 * @param crc1[in] CRC of the first part
+	 * @param crc2[in] CRC of the second part
+	 * @param len2[in] The length of the second part
+	 */
+	inline constexpr uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, size_t len2) {
+		return crc32c_detail::shift(crc1, len2) ^ crc2;
+	}
+
+}
+
+#endif //UTIL_CRC32C_H
@@ -0,0 +1,117 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/8
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <logger/logger.h>
+#include <memory/arena.h>
+
+#include "test_case.h"
+
+namespace {
+
+	constexpr size_t BENCH_NUM_TRANSACTION = 20000;
+
+	/// The number of scratch objects built by each transaction
+	constexpr size_t BENCH_NUM_OBJECT = 1000;
+
+	constexpr size_t get_object_size(size_t index) {
+		// Entries of read/write sets, with an occasional log buffer
+		return index % 64 == 0 ? 4096 : 16 + (index % 8) * 24;
+	}
+
+	struct Tracked {
+		int *counter;
+
+		explicit Tracked(int *counter): counter(counter) {}
+
+		~Tracked() { ++*counter; }
+	};
+
+	/*!
+	 * @return Million objects per second
+	 */
+	template<class TxFunc>
+	double bench_transaction(TxFunc &&tx_func) {
+		auto start_time = std::chrono::steady_clock::now();
+		for (size_t tx = 0; tx < BENCH_NUM_TRANSACTION; ++tx) {
+			tx_func();
+		}
+		auto end_time = std::chrono::steady_clock::now();
+
+		double seconds = std::chrono::duration<double>(end_time - start_time).count();
+		return static_cast<double>(BENCH_NUM_TRANSACTION * BENCH_NUM_OBJECT) / seconds / 1e6;
+	}
+
+	/*!
+	 * @brief Check that rollback and reset destroy exactly the objects created after the position
+	 */
+	bool check_destructors(Arena &arena) {
+		int num_destroyed = 0;
+		arena.create<Tracked>(&num_destroyed);
+		auto marker = arena.get_marker();
+		for (int i = 0; i < 3; ++i) {
+			arena.create<Tracked>(&num_destroyed);
+			// Force new chunks between objects
+			arena.allocate(ARENA_CHUNK_SIZE);
+		}
+		arena.rollback(marker);
+		bool res = num_destroyed == 3;
+		arena.reset();
+		return res && num_destroyed == 4;
+	}
+
+}
+
+/*
+ * Usage: util_test arena_bench
+ * Compare the cost of scratch objects of transactions between Arena and malloc/free.
+ */
+UTIL_TEST_CASE(arena_bench) {
+	Arena &arena = get_thread_arena();
+	int res = 0;
+
+	if (!check_destructors(arena)) {
+		util::logger_error("Arena destroys wrong objects on rollback or reset");
+		res = -1;
+	}
+
+	void *ptr_array[BENCH_NUM_OBJECT];
+	uint64_t checksum = 0;
+
+	double arena_throughput = bench_transaction([&]() {
+		for (size_t i = 0; i < BENCH_NUM_OBJECT; ++i) {
+			ptr_array[i] = arena.allocate(get_object_size(i));
+			*static_cast<uint64_t *>(ptr_array[i]) = i;
+		}
+		checksum += *static_cast<uint64_t *>(ptr_array[BENCH_NUM_OBJECT - 1]);
+		arena.reset();
+	});
+	double malloc_throughput = bench_transaction([&]() {
+		for (size_t i = 0; i < BENCH_NUM_OBJECT; ++i) {
+			ptr_array[i] = std::malloc(get_object_size(i));
+			*static_cast<uint64_t *>(ptr_array[i]) = i;
+		}
+		checksum += *static_cast<uint64_t *>(ptr_array[BENCH_NUM_OBJECT - 1]);
+		for (size_t i = 0; i < BENCH_NUM_OBJECT; ++i) {
+			std::free(ptr_array[i]);
+		}
+	});
+
+	util::logger_print_property("Transaction Scratch Memory",
+	                            std::make_tuple("Objects per transaction", BENCH_NUM_OBJECT, ""),
+	                            std::make_tuple("Arena", arena_throughput, "Mobj/s"),
+	                            std::make_tuple("malloc/free", malloc_throughput, "Mobj/s"),
+	                            std::make_tuple("Arena reserved", arena.get_reserved_size(), "B"));
+
+	if (checksum != 2 * BENCH_NUM_TRANSACTION * (BENCH_NUM_OBJECT - 1)) {
+		util::logger_error("Scratch objects are corrupted");
+		res = -1;
+	}
+	return res;
+}
@@ -0,0 +1,109 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/13
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include <logger/logger.h>
+#include <arch/cpu_feature.h>
+#include <util/crc32c.h>
+#include <memory/memory_config.h>
+#include <memory/ntstore_crc32c.h>
+
+#include "test_case.h"
+
+namespace {
+
+	/// Total bytes checksummed for each data point
+	constexpr size_t BENCH_TOTAL_SIZE = 256_MB;
+
+	constexpr size_t BENCH_SIZE_ARRAY[] = { 256, 768, 1_KB, 4_KB, 64_KB, 1_MB };
+
+	/// Destination offset of the fused copy, which leaves a head in the first cache line
+	constexpr size_t UNALIGNED_OFFSET = 13;
+
+	/*!
+	 * @brief CRC32C by a plain loop of the crc32 instruction, as the baseline of interleave
+	 */
+	__attribute__((target("sse4.2")))
+	uint32_t crc32c_serial(const void *data, size_t len, uint32_t crc = 0) {
+		return ~util::crc32c_detail::update_hw_serial(~crc, static_cast<const uint8_t *>(data), len);
+	}
+
+	/*!
+	 * @return Nanoseconds per call
+	 */
+	template<class Func>
+	double bench_crc32c(Func &&func, const uint8_t *src, size_t size) {
+		size_t num_iteration = BENCH_TOTAL_SIZE / size;
+
+		uint32_t crc = 0;
+		auto start_time = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < num_iteration; ++i) {
+			crc = func(src, size, crc);
+		}
+		auto end_time = std::chrono::steady_clock::now();
+		asm volatile("" : : "r"(crc));
+
+		return std::chrono::duration<double, std::nano>(end_time - start_time).count() / static_cast<double>(num_iteration);
+	}
+
+}
+
+/*
+ * Usage: util_test crc32c_bench
+ * Compare latency of CRC32C with 3-way interleave against a plain loop of the crc32 instruction,
+ * from 256 B to 1 MiB, and check the result of each implementation.
+ */
+UTIL_TEST_CASE(crc32c_bench) {
+	const CPUFeature &feature = get_cpu_feature();
+	if (!feature.sse4_2 || !feature.pclmul) {
+		util::logger_warn("CRC32C benchmark is skipped without SSE4.2 and PCLMULQDQ");
+		return 0;
+	}
+
+	int res = 0;
+	constexpr char CHECK_DATA[] = "123456789";
+	constexpr uint32_t CHECK_CRC = 0xE3069283;
+	if (util::crc32c(CHECK_DATA, 9) != CHECK_CRC || util::crc32c_sw(CHECK_DATA, 9) != CHECK_CRC ||
+	    crc32c_serial(CHECK_DATA, 9) != CHECK_CRC) {
+		util::logger_error("CRC32C mismatches with the check value");
+		res = -1;
+	}
+
+	size_t buffer_size = BENCH_SIZE_ARRAY[std::size(BENCH_SIZE_ARRAY) - 1] + 2 * CACHE_LINE_SIZE;
+	auto *src  = static_cast<uint8_t *>(std::aligned_alloc(MEM_PAGE_SIZE, buffer_size));
+	auto *dest = static_cast<uint8_t *>(std::aligned_alloc(MEM_PAGE_SIZE, buffer_size));
+	for (size_t i = 0; i < buffer_size; ++i) {
+		src[i] = static_cast<uint8_t>(i * 131);
+	}
+
+	for (size_t size: BENCH_SIZE_ARRAY) {
+		uint32_t expected_crc = util::crc32c_sw(src, size);
+		if (util::crc32c(src, size) != expected_crc || crc32c_serial(src, size) != expected_crc ||
+		    memcpy_movnt_crc32c(dest + UNALIGNED_OFFSET, src, size) != expected_crc) {
+			util::logger_error("CRC32C mismatches with the table-driven one with size ", size);
+			res = -1;
+		}
+		sfence();
+
+		double interleave_latency = bench_crc32c([](const uint8_t *data, size_t len, uint32_t crc) {
+			return util::crc32c(data, len, crc);
+		}, src, size);
+		double serial_latency = bench_crc32c([](const uint8_t *data, size_t len, uint32_t crc) {
+			return crc32c_serial(data, len, crc);
+		}, src, size);
+
+		util::logger_print_property("CRC32C",
+		                            std::make_tuple("Size", size, "B"),
+		                            std::make_tuple("Interleave latency", interleave_latency, "ns"),
+		                            std::make_tuple("Serial latency", serial_latency, "ns"));
+	}
+
+	std::free(src);
+	std::free(dest);
+	return res;
+}
@@ -1,13 +1,156 @@
 /*
- * @author: BL-GS 
+ * @author: BL-GS
  * @date:   2023/3/15
  */
 
+#include <chrono>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
 #include <vector>
 
-int main() {
+#include <logger/logger.h>
+#include <util/simple_hash.h>
+#include <thread/thread_worker.h>
+#include <memory/dram_allocator.h>
 
+#include "test_case.h"
 
-	return 0;
-}
\ No newline at end of file
+namespace {
+
+	constexpr int TEST_NUM_THREAD = 4;
+
+	constexpr size_t TEST_NUM_ROUND = 20000;
+
+	constexpr size_t TEST_NUM_LIVE = 256;
+
+	constexpr size_t BENCH_NUM_OP = 1000000;
+
+	struct Allocation {
+		uint8_t *ptr;
+		size_t size;
+		uint8_t pattern;
+	};
+
+	size_t get_test_size(size_t seed) {
+		// Mostly small objects, with some larger than the biggest size class
+		constexpr size_t SIZE_ARRAY[] = { 1, 8, 63, 64, 65, 200, 512, 513, 1000, 4096, 20000, 32768, 40000 };
+		return SIZE_ARRAY[seed % std::size(SIZE_ARRAY)];
+	}
+
+	/*!
+	 * @brief Allocate and free objects randomly, checking that no live objects overlap
+	 * @return The number of corrupted objects
+	 */
+	size_t check_allocator(DRAMAllocator &allocator, size_t seed) {
+		std::vector<Allocation> live_array(TEST_NUM_LIVE, Allocation{nullptr, 0, 0});
+		size_t num_error = 0;
+
+		auto check_and_free = [&](Allocation &allocation) {
+			if (allocation.ptr == nullptr) { return; }
+			for (size_t i = 0; i < allocation.size; ++i) {
+				if (allocation.ptr[i] != allocation.pattern) {
+					++num_error;
+					break;
+				}
+			}
+			allocator.deallocate(allocation.ptr, allocation.size);
+			allocation.ptr = nullptr;
+		};
+
+		for (size_t round = 0; round < TEST_NUM_ROUND; ++round) {
+			size_t rand_val = util::fnvhash(seed * TEST_NUM_ROUND + round);
+			auto &allocation = live_array[rand_val % TEST_NUM_LIVE];
+			check_and_free(allocation);
+
+			allocation.size    = get_test_size(rand_val >> 16);
+			allocation.pattern = static_cast<uint8_t>(rand_val >> 8);
+			allocation.ptr     = static_cast<uint8_t *>(allocator.allocate(allocation.size));
+			if (allocation.ptr == nullptr || reinterpret_cast<uintptr_t>(allocation.ptr) % CACHE_LINE_SIZE != 0) {
+				++num_error;
+				allocation.ptr = nullptr;
+				continue;
+			}
+			std::memset(allocation.ptr, allocation.pattern, allocation.size);
+		}
+
+		for (auto &allocation: live_array) {
+			check_and_free(allocation);
+		}
+		return num_error;
+	}
+
+	/*!
+	 * @brief Measure the throughput of pairs of allocation and free, excluding the launch of workers
+	 * @return Million pairs per second
+	 */
+	template<class AllocFunc, class FreeFunc>
+	double bench_throughput(int num_thread, AllocFunc &&alloc_func, FreeFunc &&free_func) {
+		std::atomic<int64_t> max_duration{0};
+		thread::run_workers_on_node(0, num_thread, [&](int) {
+			constexpr size_t BATCH = 64;
+			void *ptr_array[BATCH];
+
+			auto start_time = std::chrono::steady_clock::now();
+			for (size_t op = 0; op < BENCH_NUM_OP; op += BATCH) {
+				for (size_t i = 0; i < BATCH; ++i) {
+					ptr_array[i] = alloc_func(get_test_size(i % 8));
+				}
+				for (size_t i = 0; i < BATCH; ++i) {
+					free_func(ptr_array[i], get_test_size(i % 8));
+				}
+			}
+			auto end_time = std::chrono::steady_clock::now();
+
+			int64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+			int64_t old_duration = max_duration.load();
+			while (old_duration < duration && !max_duration.compare_exchange_weak(old_duration, duration)) {}
+		});
+
+		double seconds = static_cast<double>(max_duration.load()) / 1e9;
+		return static_cast<double>(BENCH_NUM_OP) * num_thread / seconds / 1e6;
+	}
+
+}
+
+/*
+ * Usage: util_test dram_allocator_test
+ * Check DRAMAllocator with registered and unregistered threads, then compare its throughput with malloc.
+ */
+UTIL_TEST_CASE(dram_allocator_test) {
+	DRAMAllocator allocator;
+	int res = 0;
+
+	// Unregistered thread goes to central freelist directly
+	if (size_t num_error = check_allocator(allocator, 0); num_error != 0) {
+		util::logger_error("DRAM allocator corrupts ", num_error, " objects in unregistered thread");
+		res = -1;
+	}
+
+	std::atomic<size_t> total_error{0};
+	thread::run_workers_on_node(0, TEST_NUM_THREAD, [&](int worker_id) {
+		total_error += check_allocator(allocator, worker_id + 1);
+		allocator.flush_thread_cache();
+	});
+	if (total_error != 0) {
+		util::logger_error("DRAM allocator corrupts ", total_error.load(), " objects in ", TEST_NUM_THREAD, " threads");
+		res = -1;
+	}
+
+	for (int num_thread: { 1, TEST_NUM_THREAD }) {
+		double dram_allocator_throughput = bench_throughput(num_thread,
+			[&](size_t size) { return allocator.allocate(size); },
+			[&](void *ptr, size_t size) { allocator.deallocate(ptr, size); });
+		double malloc_throughput = bench_throughput(num_thread,
+			[](size_t size) { return std::malloc(size); },
+			[](void *ptr, size_t) { std::free(ptr); });
+
+		util::logger_print_property("DRAM Allocator",
+		                            std::make_tuple("Thread number", num_thread, ""),
+		                            std::make_tuple("DRAMAllocator", dram_allocator_throughput, "Mops/s"),
+		                            std::make_tuple("malloc", malloc_throughput, "Mops/s"));
+	}
+
+	return res;
+}
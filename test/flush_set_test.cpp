@@ -0,0 +1,144 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/14
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <logger/logger.h>
+#include <memory/memory_config.h>
+#include <memory/nvm_simulator.h>
+#include <memory/flush_set.h>
+
+#include "test_case.h"
+
+namespace {
+
+	/*!
+	 * @brief Simulated policy counting flushes and fences
+	 */
+	struct NVMCounted {
+		static inline uint64_t num_pwb   = 0;
+		static inline uint64_t num_fence = 0;
+
+		static void pwb(void *target) {
+			++num_pwb;
+			NVMSimulated::pwb(target);
+		}
+
+		static void pwb_range(void *start_ptr, uint32_t size) {
+			NVMSimulated::pwb_range(start_ptr, size);
+		}
+
+		static void fence() {
+			++num_fence;
+			NVMSimulated::fence();
+		}
+	};
+
+	constexpr size_t TEST_NUM_LINE = 16;
+
+	constexpr uint32_t TEST_SMALL_CAPACITY = 4;
+
+	struct alignas(CACHE_LINE_SIZE) Line {
+		uint64_t word[CACHE_LINE_SIZE / sizeof(uint64_t)];
+	};
+
+	/*!
+	 * @brief Modify lines in [begin, end)
+	 */
+	void modify_lines(Line *line_array, size_t begin, size_t end, uint64_t value) {
+		for (size_t i = begin; i < end; ++i) {
+			line_array[i].word[0] = value;
+			line_array[i].word[7] = value;
+		}
+	}
+
+}
+
+/*
+ * Usage: util_test flush_set_test
+ * Record lines with duplicates in a flush set under the persistence simulator, and check that each
+ * line is flushed once with one fence, that a new epoch forgets recorded lines, and that a full set
+ * flushes early without fence.
+ */
+UTIL_TEST_CASE(flush_set_test) {
+	auto *line_array = static_cast<Line *>(std::aligned_alloc(CACHE_LINE_SIZE, TEST_NUM_LINE * sizeof(Line)));
+	std::memset(line_array, 0, TEST_NUM_LINE * sizeof(Line));
+	NVM_SIMULATOR.attach(line_array, TEST_NUM_LINE * sizeof(Line));
+
+	int res = 0;
+	FlushSet<NVMCounted> flush_set;
+
+	// Duplicate lines by single words, ranges and unaligned ranges
+	modify_lines(line_array, 0, 8, 1);
+	for (size_t i = 0; i < 8; ++i) {
+		flush_set.add(&line_array[i].word[0]);
+		flush_set.add(&line_array[i].word[7]);
+	}
+	flush_set.add_range(&line_array[2], 4 * sizeof(Line));
+	flush_set.add_range(&line_array[5].word[3], sizeof(Line));
+	if (flush_set.size() != 8 || !flush_set.contains(&line_array[7].word[4]) || flush_set.contains(&line_array[8])) {
+		util::logger_error("Flush set records ", flush_set.size(), " lines, expecting 8 distinct lines");
+		res = -1;
+	}
+	flush_set.drain();
+	if (NVMCounted::num_pwb != 8 || NVMCounted::num_fence != 1 || !NVM_SIMULATOR.get_unpersisted_lines().empty()) {
+		util::logger_error("Flush set drains 8 lines by ", NVMCounted::num_pwb, " flushes and ", NVMCounted::num_fence, " fences");
+		res = -1;
+	}
+
+	// A new epoch forgets lines of the last one
+	if (!flush_set.empty() || flush_set.contains(&line_array[0])) {
+		util::logger_error("Flush set keeps lines after drain");
+		res = -1;
+	}
+	modify_lines(line_array, 0, 2, 2);
+	flush_set.add(&line_array[0]);
+	flush_set.add(&line_array[1]);
+	flush_set.reset_epoch();
+	if (!flush_set.empty() || flush_set.contains(&line_array[0]) || NVMCounted::num_pwb != 8 ||
+	    NVM_SIMULATOR.get_line_state(&line_array[0]) != SimulatedLineState::DIRTY) {
+		util::logger_error("Flush set flushes or keeps lines after reset of epoch");
+		res = -1;
+	}
+	flush_set.add(&line_array[0]);
+	flush_set.add(&line_array[1]);
+	flush_set.drain();
+	if (NVMCounted::num_pwb != 10 || !NVM_SIMULATOR.get_unpersisted_lines().empty()) {
+		util::logger_error("Flush set fails to record lines again in a new epoch");
+		res = -1;
+	}
+
+	// Many epochs, where stale slots should never be taken as occupied
+	for (uint64_t epoch = 0; epoch < 1000; ++epoch) {
+		flush_set.add(&line_array[epoch % TEST_NUM_LINE]);
+		if (flush_set.size() != 1 || flush_set.contains(&line_array[(epoch + 1) % TEST_NUM_LINE])) {
+			util::logger_error("Flush set confuses lines of an earlier epoch at epoch ", epoch);
+			res = -1;
+			break;
+		}
+		flush_set.reset_epoch();
+	}
+
+	// A full set flushes early without fence
+	FlushSet<NVMCounted, TEST_SMALL_CAPACITY> small_set;
+	NVMCounted::num_pwb = NVMCounted::num_fence = 0;
+	modify_lines(line_array, 8, 14, 3);
+	small_set.add_range(&line_array[8], 6 * sizeof(Line));
+	if (NVMCounted::num_pwb != TEST_SMALL_CAPACITY || NVMCounted::num_fence != 0 || small_set.size() != 2) {
+		util::logger_error("Full flush set flushes ", NVMCounted::num_pwb, " lines early with ", NVMCounted::num_fence, " fences");
+		res = -1;
+	}
+	small_set.drain();
+	if (NVMCounted::num_pwb != 6 || NVMCounted::num_fence != 1 || !NVM_SIMULATOR.get_unpersisted_lines().empty()) {
+		util::logger_error("Full flush set loses lines flushed early");
+		res = -1;
+	}
+
+	NVM_SIMULATOR.detach();
+	std::free(line_array);
+	return res;
+}
@@ -0,0 +1,107 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/14
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+#include <logger/logger.h>
+#include <memory/file_descriptor.h>
+#include <memory/growable_region.h>
+
+#include "test_case.h"
+
+namespace {
+
+	constexpr size_t TEST_CHUNK_SIZE = 64_KB;
+
+	constexpr size_t TEST_INITIAL_SIZE = 100_KB;
+
+	constexpr size_t TEST_RESERVE_SIZE = 1_MB;
+
+	uint8_t get_pattern(size_t offset) {
+		return static_cast<uint8_t>(offset * 131 + offset / 4096);
+	}
+
+	void fill_pattern(uint8_t *start_ptr, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			start_ptr[i] = get_pattern(i);
+		}
+	}
+
+	bool check_pattern(const uint8_t *start_ptr, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			if (start_ptr[i] != get_pattern(i)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+}
+
+/*
+ * Usage: util_test growable_region_test
+ * Grow a region chunk by chunk up to its reservation, checking that the region never moves and
+ * data written before growth keeps readable, and reopen the file with its grown size.
+ */
+UTIL_TEST_CASE(growable_region_test) {
+	std::string dir_name = std::filesystem::temp_directory_path().string();
+	int res = 0;
+
+	uint8_t *start_ptr;
+	size_t grown_size;
+	{
+		GrowableRegion region(dir_name, "util_growable_region_test", TEST_INITIAL_SIZE, TEST_RESERVE_SIZE,
+		                      FileMode::CREATE, TEST_CHUNK_SIZE);
+		start_ptr = region.get_start_ptr();
+		if (region.get_mapped_size() != 2 * TEST_CHUNK_SIZE) {
+			util::logger_error("Growable region maps ", region.get_mapped_size(), " bytes initially, expecting whole chunks");
+			res = -1;
+		}
+
+		// A pointer taken before growth, which should keep valid
+		uint8_t *first_ptr = start_ptr + 100;
+		fill_pattern(start_ptr, 0, region.get_mapped_size());
+		while (region.get_mapped_size() < region.get_reserve_size()) {
+			size_t old_size = region.get_mapped_size();
+			if (!region.grow_chunk() || region.get_mapped_size() != old_size + TEST_CHUNK_SIZE) {
+				util::logger_error("Growable region fails to grow by one chunk from ", old_size, " bytes");
+				res = -1;
+				break;
+			}
+			fill_pattern(start_ptr, old_size, region.get_mapped_size());
+		}
+		grown_size = region.get_mapped_size();
+
+		if (region.get_start_ptr() != start_ptr || *first_ptr != get_pattern(100) || !check_pattern(start_ptr, 0, grown_size)) {
+			util::logger_error("Growable region moves or loses data during growth");
+			res = -1;
+		}
+		if (!region.contains(start_ptr + grown_size - 1) || region.contains(start_ptr + grown_size)) {
+			util::logger_error("Growable region contains addresses out of the mapped range");
+			res = -1;
+		}
+		if (region.grow(TEST_RESERVE_SIZE + 1) || region.get_mapped_size() != grown_size) {
+			util::logger_error("Growable region grows beyond its reservation");
+			res = -1;
+		}
+	}
+
+	{
+		// The opened file keeps its size, which is larger than the initial size
+		GrowableRegion region(dir_name, "util_growable_region_test", TEST_CHUNK_SIZE, TEST_RESERVE_SIZE,
+		                      FileMode::OPEN, TEST_CHUNK_SIZE);
+		region.remove_on_close = true;
+		if (region.get_mapped_size() != grown_size || !check_pattern(region.get_start_ptr(), 0, grown_size)) {
+			util::logger_error("Growable region maps ", region.get_mapped_size(), " bytes after reopen, expecting ", grown_size,
+			                   " bytes with data written before");
+			res = -1;
+		}
+	}
+
+	return res;
+}
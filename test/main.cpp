@@ -0,0 +1,35 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/6/26
+ */
+
+#include <cstdio>
+
+#include "test_case.h"
+
+/*
+ * Usage: util_test [case_name [args...]]
+ * Run all registered cases if no case is specified.
+ */
+int main(int argc, char **argv) {
+	auto &test_case_map = util::test::get_test_case_map();
+
+	if (argc > 1) {
+		auto iter = test_case_map.find(argv[1]);
+		if (iter == test_case_map.end()) {
+			std::fprintf(stderr, "Unknown test case: %s\n", argv[1]);
+			return -1;
+		}
+		return iter->second(argc - 1, argv + 1);
+	}
+
+	int res = 0;
+	for (auto &[name, func]: test_case_map) {
+		std::printf("Run test case: %s\n", name.c_str());
+		if (func(argc, argv) != 0) {
+			std::fprintf(stderr, "Failed test case: %s\n", name.c_str());
+			res = -1;
+		}
+	}
+	return res;
+}
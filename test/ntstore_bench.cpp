@@ -0,0 +1,79 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/6/27
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include <logger/logger.h>
+#include <reflection/enum.h>
+#include <memory/memory_config.h>
+#include <memory/ntstore.h>
+#include <memory/flush.h>
+
+#include "test_case.h"
+
+namespace {
+
+	/// Total bytes copied for each data point
+	constexpr size_t BENCH_TOTAL_SIZE = 64_MB;
+
+	constexpr size_t BENCH_MIN_SIZE = 64;
+
+	constexpr size_t BENCH_MAX_SIZE = 1_MB;
+
+	/// Destination offset of the unaligned case, which leaves a head in the first cache line
+	constexpr size_t UNALIGNED_OFFSET = 13;
+
+	double bench_memcpy_movnt(uint8_t *dest, const uint8_t *src, size_t copy_size) {
+		size_t num_iteration = BENCH_TOTAL_SIZE / copy_size;
+
+		auto start_time = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < num_iteration; ++i) {
+			memcpy_movnt(dest, src, copy_size);
+		}
+		sfence();
+		auto end_time = std::chrono::steady_clock::now();
+
+		double seconds = std::chrono::duration<double>(end_time - start_time).count();
+		return static_cast<double>(num_iteration * copy_size) / seconds / 1_GB;
+	}
+
+}
+
+/*
+ * Usage: util_test ntstore_bench
+ * Compare throughput of non-temporal copy on aligned and unaligned destination, from 64 B to 1 MiB.
+ */
+UTIL_TEST_CASE(ntstore_bench) {
+	size_t buffer_size = BENCH_MAX_SIZE + 2 * CACHE_LINE_SIZE;
+	auto *src  = static_cast<uint8_t *>(std::aligned_alloc(MEM_PAGE_SIZE, buffer_size));
+	auto *dest = static_cast<uint8_t *>(std::aligned_alloc(MEM_PAGE_SIZE, buffer_size));
+	for (size_t i = 0; i < buffer_size; ++i) {
+		src[i] = static_cast<uint8_t>(i * 131);
+	}
+	std::memset(dest, 0, buffer_size);
+
+	int res = 0;
+	for (size_t copy_size = BENCH_MIN_SIZE; copy_size <= BENCH_MAX_SIZE; copy_size *= 4) {
+		double aligned_bandwidth   = bench_memcpy_movnt(dest, src, copy_size);
+		double unaligned_bandwidth = bench_memcpy_movnt(dest + UNALIGNED_OFFSET, src, copy_size);
+
+		util::logger_print_property("Non-temporal Copy",
+		                            std::make_tuple("ISA", util::get_enum_name(get_ntstore_kernel().isa), ""),
+		                            std::make_tuple("Copy size", copy_size, "B"),
+		                            std::make_tuple("Aligned bandwidth", aligned_bandwidth, "GB/s"),
+		                            std::make_tuple("Unaligned bandwidth", unaligned_bandwidth, "GB/s"));
+
+		if (std::memcmp(dest + UNALIGNED_OFFSET, src, copy_size) != 0) {
+			util::logger_error("Copied data mismatches with size ", copy_size);
+			res = -1;
+		}
+	}
+
+	std::free(src);
+	std::free(dest);
+	return res;
+}
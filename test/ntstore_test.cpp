@@ -0,0 +1,185 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/14
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+#include <logger/logger.h>
+#include <reflection/enum.h>
+#include <memory/memory_config.h>
+#include <memory/ntstore.h>
+#include <memory/nvm_config.h>
+#include <memory/persist.h>
+
+#include "test_case.h"
+
+namespace {
+
+	/// Sizes around the widths of stores and cache lines, and larger than the aligned body
+	constexpr size_t TEST_SIZE_ARRAY[] = {
+		0, 1, 3, 4, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128, 129,
+		191, 255, 256, 257, 511, 1000, 4096, 4096 + 13, 64_KB + 7
+	};
+
+	constexpr size_t TEST_OFFSET_ARRAY[] = { 0, 1, 8, 13, 32, 63 };
+
+	/// Distances between source and destination of overlapping moves
+	constexpr size_t TEST_OVERLAP_ARRAY[] = { 1, 8, 31, 64, 100, 4096 };
+
+	constexpr size_t TEST_MAX_SIZE = 64_KB + 7;
+
+	/// Room for offsets and overlaps around the range, whose bytes should never be modified
+	constexpr size_t TEST_BUFFER_SIZE = TEST_MAX_SIZE + 2 * 4096 + 2 * CACHE_LINE_SIZE;
+
+	constexpr size_t TEST_GUARD_SIZE = 4096 + CACHE_LINE_SIZE;
+
+	/// Operation applied to a buffer, as the operation under test or as the reference of libc
+	using BufferOp = std::function<void(uint8_t *buffer)>;
+
+	class Checker {
+	private:
+		uint8_t *buffer_;
+
+		uint8_t *expected_;
+
+		uint8_t *src_;
+
+	public:
+		Checker():
+				buffer_(static_cast<uint8_t *>(std::aligned_alloc(MEM_PAGE_SIZE, TEST_BUFFER_SIZE))),
+				expected_(static_cast<uint8_t *>(std::aligned_alloc(MEM_PAGE_SIZE, TEST_BUFFER_SIZE))),
+				src_(static_cast<uint8_t *>(std::aligned_alloc(MEM_PAGE_SIZE, TEST_BUFFER_SIZE))) {
+			for (size_t i = 0; i < TEST_BUFFER_SIZE; ++i) {
+				src_[i] = static_cast<uint8_t>(i * 131 + 7);
+			}
+		}
+
+		~Checker() {
+			std::free(buffer_);
+			std::free(expected_);
+			std::free(src_);
+		}
+
+		[[nodiscard]] const uint8_t *get_src(size_t offset) const {
+			return src_ + TEST_GUARD_SIZE + offset;
+		}
+
+		/*!
+		 * @brief Apply both operations to the same initial content and compare whole buffers
+		 */
+		bool check(const BufferOp &op, const BufferOp &reference_op) {
+			for (size_t i = 0; i < TEST_BUFFER_SIZE; ++i) {
+				buffer_[i] = expected_[i] = static_cast<uint8_t>(i * 17 + 3);
+			}
+			op(buffer_ + TEST_GUARD_SIZE);
+			sfence();
+			reference_op(expected_ + TEST_GUARD_SIZE);
+			return std::memcmp(buffer_, expected_, TEST_BUFFER_SIZE) == 0;
+		}
+	};
+
+	/*!
+	 * @brief Check memcpy, memset and memmove of both directions of a kernel against libc
+	 * @return The number of failed cases
+	 */
+	size_t check_kernel(Checker &checker, const NTStoreKernel &kernel) {
+		size_t num_error = 0;
+		auto report = [&](const char *op_name, size_t size, size_t offset, size_t other) {
+			util::logger_error("Non-temporal ", op_name, " of ", util::get_enum_name(kernel.isa), " mismatches with libc: ",
+			                   "size ", size, ", offset ", offset, ", source offset or overlap ", other);
+			++num_error;
+		};
+
+		for (size_t size: TEST_SIZE_ARRAY) {
+			for (size_t offset: TEST_OFFSET_ARRAY) {
+				for (size_t src_offset: { size_t{0}, size_t{5}, size_t{CACHE_LINE_SIZE} }) {
+					const uint8_t *src = checker.get_src(src_offset);
+					if (!checker.check([&](uint8_t *buffer) { kernel.memcpy(buffer + offset, src, size); },
+					                   [&](uint8_t *buffer) { std::memcpy(buffer + offset, src, size); })) {
+						report("memcpy", size, offset, src_offset);
+					}
+					if (!checker.check([&](uint8_t *buffer) { kernel.memmove(buffer + offset, src, size); },
+					                   [&](uint8_t *buffer) { std::memmove(buffer + offset, src, size); })) {
+						report("memmove", size, offset, src_offset);
+					}
+				}
+
+				if (!checker.check([&](uint8_t *buffer) { kernel.memset(buffer + offset, 0xA5, size); },
+				                   [&](uint8_t *buffer) { std::memset(buffer + offset, 0xA5, size); })) {
+					report("memset", size, offset, 0);
+				}
+
+				// Overlapping moves, forward (destination before source) and backward
+				for (size_t overlap: TEST_OVERLAP_ARRAY) {
+					if (!checker.check([&](uint8_t *buffer) { kernel.memmove(buffer + offset, buffer + offset + overlap, size); },
+					                   [&](uint8_t *buffer) { std::memmove(buffer + offset, buffer + offset + overlap, size); })) {
+						report("forward memmove", size, offset, overlap);
+					}
+					if (!checker.check([&](uint8_t *buffer) { kernel.memmove(buffer + offset + overlap, buffer + offset, size); },
+					                   [&](uint8_t *buffer) { std::memmove(buffer + offset + overlap, buffer + offset, size); })) {
+						report("backward memmove", size, offset, overlap);
+					}
+				}
+			}
+		}
+		return num_error;
+	}
+
+	/*!
+	 * @brief Check persist_memcpy and persist_memset with temporal, non-temporal and automatic stores
+	 * @return The number of failed cases
+	 */
+	size_t check_persist(Checker &checker) {
+		size_t num_error = 0;
+		for (PersistFlag flags: { PersistFlag::NONE, PersistFlag::TEMPORAL, PersistFlag::NON_TEMPORAL }) {
+			for (size_t size: TEST_SIZE_ARRAY) {
+				for (size_t offset: TEST_OFFSET_ARRAY) {
+					const uint8_t *src = checker.get_src(5);
+					if (!checker.check([&](uint8_t *buffer) { persist_memcpy<NVMRuntime>(buffer + offset, src, size, flags); },
+					                   [&](uint8_t *buffer) { std::memcpy(buffer + offset, src, size); })) {
+						util::logger_error("persist_memcpy mismatches with libc: size ", size, ", offset ", offset,
+						                   ", flags ", static_cast<uint32_t>(flags));
+						++num_error;
+					}
+					if (!checker.check([&](uint8_t *buffer) { persist_memset<NVMRuntime>(buffer + offset, 0x5A, size, flags); },
+					                   [&](uint8_t *buffer) { std::memset(buffer + offset, 0x5A, size); })) {
+						util::logger_error("persist_memset mismatches with libc: size ", size, ", offset ", offset,
+						                   ", flags ", static_cast<uint32_t>(flags));
+						++num_error;
+					}
+				}
+			}
+		}
+		return num_error;
+	}
+
+}
+
+/*
+ * Usage: util_test ntstore_test
+ * Compare non-temporal memcpy, memmove (forward, backward and overlapping) and memset of every kernel
+ * supported by the running cpu, and persist_memcpy/persist_memset, against libc over sizes and
+ * offsets. Bytes around the destination should never be modified.
+ */
+UTIL_TEST_CASE(ntstore_test) {
+	Checker checker;
+	int res = 0;
+
+	for (NTStoreISA isa: { NTStoreISA::SSE2, NTStoreISA::AVX2, NTStoreISA::AVX512F }) {
+		if (!is_ntstore_isa_supported(isa)) {
+			util::logger_warn("Non-temporal kernels of ", util::get_enum_name(isa), " are skipped on this cpu");
+			continue;
+		}
+		if (check_kernel(checker, select_ntstore_kernel(isa)) != 0) {
+			res = -1;
+		}
+	}
+	if (check_persist(checker) != 0) {
+		res = -1;
+	}
+	return res;
+}
@@ -0,0 +1,108 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/14
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+
+#include <logger/logger.h>
+#include <memory/memory_config.h>
+#include <memory/nvm_simulator.h>
+
+#include "test_case.h"
+
+namespace {
+
+	constexpr size_t TEST_REGION_SIZE = 4 * CACHE_LINE_SIZE;
+
+	/// The line under test, whose neighbours are never modified
+	constexpr size_t TEST_LINE_INDEX = 1;
+
+	/*!
+	 * @brief Get contents of the line under test in all crash images, identified by their first word
+	 */
+	std::set<uint64_t> get_crash_contents(uint64_t &num_image) {
+		std::set<uint64_t> res;
+		num_image = NVM_SIMULATOR.for_each_crash_image([&](const uint8_t *image, size_t) {
+			uint64_t word;
+			std::memcpy(&word, image + TEST_LINE_INDEX * CACHE_LINE_SIZE, sizeof(uint64_t));
+			res.emplace(word);
+		});
+		return res;
+	}
+
+	bool check_crash_contents(const std::set<uint64_t> &expected, const char *name) {
+		uint64_t num_image = 0;
+		std::set<uint64_t> content_set = get_crash_contents(num_image);
+		if (content_set != expected || num_image != expected.size()) {
+			util::logger_error("Simulator leaves ", num_image, " crash images with ", content_set.size(),
+			                   " contents of line ", name, ", expecting ", expected.size());
+			return false;
+		}
+		return true;
+	}
+
+}
+
+/*
+ * Usage: util_test nvm_simulator_test
+ * Flush a line twice with different contents and no fence between them, and check that a crash
+ * may leave either flushed content, that the latest one is persisted by fence, and that line states
+ * follow the latest flush.
+ */
+UTIL_TEST_CASE(nvm_simulator_test) {
+	auto *region = static_cast<uint8_t *>(std::aligned_alloc(CACHE_LINE_SIZE, TEST_REGION_SIZE));
+	std::memset(region, 0, TEST_REGION_SIZE);
+	auto *word = reinterpret_cast<uint64_t *>(region + TEST_LINE_INDEX * CACHE_LINE_SIZE);
+	NVM_SIMULATOR.attach(region, TEST_REGION_SIZE);
+
+	int res = 0;
+
+	// pwb, store, pwb
+	*word = 1;
+	NVMSimulated::pwb(word);
+	*word = 2;
+	NVMSimulated::pwb(word);
+	if (!check_crash_contents({ 0, 1, 2 }, "flushed twice")) {
+		res = -1;
+	}
+	if (NVM_SIMULATOR.get_line_state(word) != SimulatedLineState::FLUSHED) {
+		util::logger_error("Simulator does not regard the line flushed after the second flush");
+		res = -1;
+	}
+
+	// Back to the content of the first flush, which is not the latest one
+	*word = 1;
+	if (NVM_SIMULATOR.get_line_state(word) != SimulatedLineState::DIRTY) {
+		util::logger_error("Simulator regards the line flushed by an earlier flush");
+		res = -1;
+	}
+	if (!check_crash_contents({ 0, 1, 2 }, "modified after flushes")) {
+		res = -1;
+	}
+
+	// The latest flush is persisted
+	NVMSimulated::fence();
+	if (!check_crash_contents({ 1, 2 }, "fenced")) {
+		res = -1;
+	}
+	NVMSimulated::pwb(word);
+	NVMSimulated::fence();
+	if (!check_crash_contents({ 1 }, "fenced again") || NVM_SIMULATOR.get_line_state(word) != SimulatedLineState::PERSISTED) {
+		res = -1;
+	}
+
+	uint64_t num_redundant = NVM_SIMULATOR.get_redundant_pwb_count();
+	NVMSimulated::pwb(word);
+	if (NVM_SIMULATOR.get_redundant_pwb_count() != num_redundant + 1) {
+		util::logger_error("Simulator does not count the flush of a persisted line as redundant");
+		res = -1;
+	}
+
+	NVM_SIMULATOR.detach();
+	std::free(region);
+	return res;
+}
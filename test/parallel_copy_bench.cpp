@@ -0,0 +1,65 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/6/26
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <arch/arch.h>
+#include <logger/logger.h>
+#include <memory/memory_config.h>
+#include <memory/parallel_copy.h>
+
+#include "test_case.h"
+
+/*
+ * Usage: util_test parallel_copy_bench [size_in_MB]
+ * Report bandwidth of parallel_persist_copy() as the number of threads grows to ARCH_CPU_LOGICAL_NUM.
+ */
+UTIL_TEST_CASE(parallel_copy_bench) {
+	size_t copy_size = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64) * 1_MB;
+
+	auto *src  = static_cast<uint8_t *>(std::aligned_alloc(MEM_PAGE_SIZE, copy_size));
+	auto *dest = static_cast<uint8_t *>(std::aligned_alloc(MEM_PAGE_SIZE, copy_size));
+	for (size_t i = 0; i < copy_size; ++i) {
+		src[i] = static_cast<uint8_t>(i * 131);
+	}
+	// Warm up pages of destination
+	std::memset(dest, 0, copy_size);
+
+	std::vector<int> num_thread_array;
+	for (int num_thread = 1; num_thread < ARCH_CPU_LOGICAL_NUM; num_thread *= 2) {
+		num_thread_array.emplace_back(num_thread);
+	}
+	num_thread_array.emplace_back(ARCH_CPU_LOGICAL_NUM);
+
+	int res = 0;
+	for (int num_thread: num_thread_array) {
+		std::memset(dest, 0, copy_size);
+
+		auto start_time = std::chrono::steady_clock::now();
+		parallel_persist_copy(dest, src, copy_size, num_thread);
+		auto end_time   = std::chrono::steady_clock::now();
+
+		double seconds   = std::chrono::duration<double>(end_time - start_time).count();
+		double bandwidth = static_cast<double>(copy_size) / seconds / 1_GB;
+
+		util::logger_print_property("Parallel Persist Copy",
+		                            std::make_tuple("Thread number", num_thread, ""),
+		                            std::make_tuple("Copy size", copy_size / 1_MB, "MB"),
+		                            std::make_tuple("Bandwidth", bandwidth, "GB/s"));
+
+		if (std::memcmp(dest, src, copy_size) != 0) {
+			util::logger_error("Copied data mismatches with ", num_thread, " threads");
+			res = -1;
+		}
+	}
+
+	std::free(src);
+	std::free(dest);
+	return res;
+}
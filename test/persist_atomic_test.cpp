@@ -0,0 +1,109 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/14
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+
+#include <logger/logger.h>
+#include <memory/file_descriptor.h>
+#include <memory/nvm_simulator.h>
+#include <memory/persist.h>
+
+#include "test_case.h"
+
+namespace {
+
+	constexpr size_t TEST_POOL_SIZE = 64_KB;
+
+	/// Offset of the value in pool, at the tail of a cache line
+	constexpr size_t TEST_OFFSET = 2 * CACHE_LINE_SIZE - 16;
+
+	struct alignas(16) VersionedPtr {
+		uint64_t ptr;
+		uint64_t version;
+
+		bool operator==(const VersionedPtr &other) const = default;
+	};
+
+	VersionedPtr get_image_value(const uint8_t *image) {
+		VersionedPtr res;
+		std::memcpy(&res, image + TEST_OFFSET, sizeof(VersionedPtr));
+		return res;
+	}
+
+}
+
+/*
+ * Usage: util_test persist_atomic_test
+ * Compare and swap a pointer with its version by persist_cas128() under the persistence simulator.
+ * A fenced swap should leave the only crash image with the new value, an unfenced one should leave
+ * the old or the new value but never a mix of them, and a failed one should flush nothing.
+ */
+UTIL_TEST_CASE(persist_atomic_test) {
+	FileDescriptor file(std::filesystem::temp_directory_path().string(), "util_persist_atomic_test", TEST_POOL_SIZE);
+	file.remove_on_close = true;
+
+	auto *value = reinterpret_cast<VersionedPtr *>(static_cast<uint8_t *>(file.aligned_start_ptr) + TEST_OFFSET);
+	*value = { 0x1000, 1 };
+	NVM_SIMULATOR.attach(file);
+
+	int res = 0;
+
+	// Fenced swap
+	VersionedPtr expected{ 0x1000, 1 };
+	const VersionedPtr fenced_value{ 0x2000, 2 };
+	if (!persist_cas128<NVMSimulated>(value, expected, fenced_value)) {
+		util::logger_error("persist_cas128 fails with the expected value");
+		res = -1;
+	}
+	uint64_t num_image = NVM_SIMULATOR.for_each_crash_image([&](const uint8_t *image, size_t) {
+		if (get_image_value(image) != fenced_value) {
+			util::logger_error("persist_cas128 loses the fenced value after crash");
+			res = -1;
+		}
+	});
+	if (num_image != 1) {
+		util::logger_error("persist_cas128 leaves ", num_image, " crash images after fence, expecting 1");
+		res = -1;
+	}
+
+	// Unfenced swap, which may or may not be persisted
+	expected = fenced_value;
+	const VersionedPtr unfenced_value{ 0x3000, 3 };
+	persist_cas128<NVMSimulated>(value, expected, unfenced_value, PersistFlag::NO_DRAIN);
+	bool has_old = false, has_new = false;
+	num_image = NVM_SIMULATOR.for_each_crash_image([&](const uint8_t *image, size_t) {
+		VersionedPtr image_value = get_image_value(image);
+		has_old = has_old || image_value == fenced_value;
+		has_new = has_new || image_value == unfenced_value;
+		if (image_value != fenced_value && image_value != unfenced_value) {
+			util::logger_error("persist_cas128 leaves a mix of old and new values after crash");
+			res = -1;
+		}
+	});
+	if (num_image != 2 || !has_old || !has_new) {
+		util::logger_error("persist_cas128 leaves ", num_image, " crash images without fence, expecting the old and the new value");
+		res = -1;
+	}
+	NVMSimulated::fence();
+
+	// Failed swap on a dirty line
+	const VersionedPtr dirty_value{ 0x4000, 4 };
+	*value = dirty_value;
+	expected = unfenced_value;
+	if (persist_cas128<NVMSimulated>(value, expected, VersionedPtr{ 0x5000, 5 }, PersistFlag::NO_DRAIN) ||
+	    expected != dirty_value) {
+		util::logger_error("persist_cas128 does not report the current value on failure");
+		res = -1;
+	}
+	if (NVM_SIMULATOR.get_line_state(value) != SimulatedLineState::DIRTY) {
+		util::logger_error("persist_cas128 flushes the line on failure");
+		res = -1;
+	}
+
+	NVM_SIMULATOR.detach();
+	return res;
+}
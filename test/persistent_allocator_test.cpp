@@ -0,0 +1,132 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/14
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <set>
+#include <vector>
+
+#include <logger/logger.h>
+#include <memory/file_descriptor.h>
+#include <memory/nvm_simulator.h>
+#include <memory/persistent_allocator.h>
+
+#include "test_case.h"
+
+namespace {
+
+	using Allocator = PersistentAllocator<NVMSimulated>;
+
+	constexpr size_t TEST_POOL_SIZE = 1_MB;
+
+	constexpr size_t TEST_NUM_SMALL = 8;
+
+	constexpr size_t TEST_NUM_LARGE = 3;
+
+	std::set<void *> get_allocated_set(const Allocator &allocator) {
+		std::set<void *> allocated_set;
+		allocator.for_each_allocated([&](void *block, uint32_t) {
+			allocated_set.emplace(block);
+		});
+		return allocated_set;
+	}
+
+	/*!
+	 * @brief Allocate small blocks until the pool is full, and check that none of them was allocated
+	 * @return The number of blocks handed out twice
+	 */
+	size_t count_double_allocation(Allocator &allocator, std::set<void *> allocated_set) {
+		size_t num_error = 0;
+		while (void *block = allocator.allocate(1)) {
+			if (!allocated_set.emplace(block).second) {
+				++num_error;
+			}
+		}
+		return num_error;
+	}
+
+}
+
+/*
+ * Usage: util_test persistent_allocator_test
+ * Allocate, publish and free blocks under the persistence simulator, and crash with some of them
+ * unfenced. Recovery of every crash image should keep fenced allocations and frees, never keep
+ * an unpublished reservation, and never hand out an allocated block again.
+ */
+UTIL_TEST_CASE(persistent_allocator_test) {
+	FileDescriptor file(std::filesystem::temp_directory_path().string(), "util_persistent_allocator_test", TEST_POOL_SIZE);
+	file.remove_on_close = true;
+
+	std::vector<void *> live_array, freed_array;
+	void *published_block, *reserved_block;
+	{
+		Allocator allocator(file);
+		NVM_SIMULATOR.attach(file);
+
+		for (size_t i = 0; i < TEST_NUM_SMALL; ++i) {
+			live_array.emplace_back(allocator.allocate(64));
+		}
+		for (size_t i = 0; i < TEST_NUM_LARGE; ++i) {
+			live_array.emplace_back(allocator.allocate(1000));
+		}
+		for (size_t i = 0; i < 2; ++i) {
+			freed_array.emplace_back(live_array.back());
+			allocator.deallocate(live_array.back());
+			live_array.pop_back();
+		}
+
+		// Not fenced: each of them may or may not be persisted
+		PersistentReservation reservation = allocator.reserve(64);
+		std::memset(reservation.ptr, 0xAB, reservation.block_size);
+		NVMSimulated::pwb_range(reservation.ptr, reservation.block_size);
+		allocator.publish(reservation);
+		published_block = reservation.ptr;
+
+		// Never published
+		reserved_block = allocator.reserve(64).ptr;
+
+		allocator.deallocate(live_array.front(), false);
+		live_array.erase(live_array.begin());
+	}
+
+	int res = 0;
+	size_t num_published = 0;
+	uint64_t num_image = NVM_SIMULATOR.for_each_crash_image([&](const uint8_t *image, size_t) {
+		NVM_SIMULATOR.load_image(image);
+		Allocator allocator(file);
+
+		auto allocated_set = get_allocated_set(allocator);
+		for (void *block: live_array) {
+			if (!allocated_set.contains(block)) {
+				util::logger_error("Persistent allocator loses an allocated block after crash");
+				res = -1;
+			}
+		}
+		for (void *block: freed_array) {
+			if (allocated_set.contains(block)) {
+				util::logger_error("Persistent allocator keeps a freed block after crash");
+				res = -1;
+			}
+		}
+		num_published += allocated_set.contains(published_block);
+		if (allocated_set.contains(reserved_block)) {
+			util::logger_error("Persistent allocator keeps an unpublished reservation after crash");
+			res = -1;
+		}
+		if (size_t num_error = count_double_allocation(allocator, allocated_set); num_error != 0) {
+			util::logger_error("Persistent allocator hands out ", num_error, " allocated blocks after crash");
+			res = -1;
+		}
+	});
+	NVM_SIMULATOR.detach();
+
+	// The unfenced publish may or may not be persisted
+	if (num_published == 0 || num_published == num_image) {
+		util::logger_error("Persistent allocator keeps the unfenced publish in ", num_published, " of ", num_image, " crash images");
+		res = -1;
+	}
+	return res;
+}
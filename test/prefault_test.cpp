@@ -0,0 +1,126 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/14
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include <logger/logger.h>
+#include <memory/memory_config.h>
+#include <memory/file_descriptor.h>
+#include <memory/prefault.h>
+
+#include "test_case.h"
+
+namespace {
+
+	constexpr size_t TEST_MAP_SIZE = 1_MB;
+
+	/// Large enough to be split among workers by parallel_prefault()
+	constexpr size_t TEST_PARALLEL_MAP_SIZE = 4 * PREFAULT_STRIPE_SIZE;
+
+	constexpr int TEST_NUM_THREAD = 2;
+
+	/*!
+	 * @brief Map anonymous memory lazily, with small pages so that each page faults by itself
+	 */
+	uint8_t *map_lazily(size_t size) {
+		void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED) {
+			perror("ERROR: mmap() is not working !!! ");
+			exit(-1);
+		}
+		madvise(ptr, size, MADV_NOHUGEPAGE);
+		return static_cast<uint8_t *>(ptr);
+	}
+
+	/*!
+	 * @brief Write each page and count page faults of the current thread
+	 */
+	long count_write_fault(uint8_t *ptr, size_t size) {
+		struct rusage usage_before{}, usage_after{};
+		getrusage(RUSAGE_THREAD, &usage_before);
+		for (size_t offset = 0; offset < size; offset += MEM_PAGE_SIZE) {
+			*static_cast<volatile uint8_t *>(ptr + offset) = 1;
+		}
+		getrusage(RUSAGE_THREAD, &usage_after);
+		return usage_after.ru_minflt - usage_before.ru_minflt;
+	}
+
+	/*!
+	 * @brief Check that writes after prefault hardly fault, allowing some noise
+	 */
+	bool check_prefaulted(uint8_t *ptr, size_t size, const char *name) {
+		long num_fault = count_write_fault(ptr, size);
+		if (num_fault > static_cast<long>(size / MEM_PAGE_SIZE / 16)) {
+			util::logger_error("Writes fault ", num_fault, " times in ", size / MEM_PAGE_SIZE, " pages after ", name);
+			return false;
+		}
+		return true;
+	}
+
+}
+
+/*
+ * Usage: util_test prefault_test
+ * Prefault lazy mappings by MADV_POPULATE_WRITE, by touching pages (the fallback), by workers and
+ * for a pool file, and check that later writes hardly fault and that touching keeps data intact.
+ */
+UTIL_TEST_CASE(prefault_test) {
+	int res = 0;
+
+	// Control group: each page faults on the first write
+	uint8_t *ptr = map_lazily(TEST_MAP_SIZE);
+	if (long num_fault = count_write_fault(ptr, TEST_MAP_SIZE); num_fault < static_cast<long>(TEST_MAP_SIZE / MEM_PAGE_SIZE / 2)) {
+		util::logger_warn("Writes to a lazy mapping fault only ", num_fault, " times, which makes the test meaningless");
+	}
+	munmap(ptr, TEST_MAP_SIZE);
+
+	// MADV_POPULATE_WRITE
+	ptr = map_lazily(TEST_MAP_SIZE);
+	if (madvise(ptr, MEM_PAGE_SIZE, MADV_POPULATE_WRITE) != 0) {
+		util::logger_warn("MADV_POPULATE_WRITE is not supported, so that prefault_range() falls back to touching pages");
+	}
+	prefault_range(ptr, TEST_MAP_SIZE);
+	res = check_prefaulted(ptr, TEST_MAP_SIZE, "prefault_range()") ? res : -1;
+	munmap(ptr, TEST_MAP_SIZE);
+
+	// Touching pages, from an unaligned start
+	ptr = map_lazily(TEST_MAP_SIZE);
+	prefault_range_by_touch(ptr + 100, TEST_MAP_SIZE - 100);
+	res = check_prefaulted(ptr, TEST_MAP_SIZE, "prefault_range_by_touch()") ? res : -1;
+	for (size_t i = 0; i < TEST_MAP_SIZE; ++i) {
+		ptr[i] = static_cast<uint8_t>(i * 131);
+	}
+	prefault_range_by_touch(ptr, TEST_MAP_SIZE);
+	for (size_t i = 0; i < TEST_MAP_SIZE; ++i) {
+		if (ptr[i] != static_cast<uint8_t>(i * 131)) {
+			util::logger_error("prefault_range_by_touch() modifies data");
+			res = -1;
+			break;
+		}
+	}
+	munmap(ptr, TEST_MAP_SIZE);
+
+	// Workers
+	ptr = map_lazily(TEST_PARALLEL_MAP_SIZE);
+	parallel_prefault(ptr, TEST_PARALLEL_MAP_SIZE, TEST_NUM_THREAD, 0);
+	res = check_prefaulted(ptr, TEST_PARALLEL_MAP_SIZE, "parallel_prefault()") ? res : -1;
+	munmap(ptr, TEST_PARALLEL_MAP_SIZE);
+
+	// Pool file mapped lazily
+	MapOption option;
+	option.populate = false;
+	FileDescriptor file(std::filesystem::temp_directory_path().string(), "util_prefault_test", TEST_MAP_SIZE,
+	                    FileMode::CREATE, 0, option);
+	file.remove_on_close = true;
+	prefault_file(file, TEST_NUM_THREAD);
+	res = check_prefaulted(file.start_ptr, file.total_size, "prefault_file()") ? res : -1;
+
+	return res;
+}
@@ -0,0 +1,133 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/14
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include <logger/logger.h>
+#include <memory/file_descriptor.h>
+#include <memory/nvm_simulator.h>
+#include <memory/redo_log.h>
+
+#include "test_case.h"
+
+namespace {
+
+	using Log = PersistentRedoLog<NVMSimulated>;
+
+	using Payload = std::vector<uint8_t>;
+
+	constexpr size_t TEST_POOL_SIZE = 256_KB;
+
+	/// Records committed before the crash
+	constexpr size_t TEST_NUM_COMMITTED = 5;
+
+	/// Lengths of records appended without commit, the first of which spans 2 lines with its header
+	constexpr size_t TEST_UNCOMMITTED_LEN_ARRAY[] = { 80, 16 };
+
+	constexpr size_t TEST_NUM_UNCOMMITTED_LINE = 3;
+
+	Payload make_payload(size_t len, uint8_t seed) {
+		Payload payload(len);
+		for (size_t i = 0; i < len; ++i) {
+			payload[i] = static_cast<uint8_t>(seed * 31 + i);
+		}
+		return payload;
+	}
+
+	/*!
+	 * @brief Recover the log from the current content of pool, as if the process restarts
+	 */
+	std::vector<Payload> recover_records(FileDescriptor &file) {
+		Log log(file, 1, 1);
+		std::vector<Payload> res;
+		log.for_each_record([&](const RedoRecord &record) {
+			res.emplace_back(record.data, record.data + record.len);
+		});
+		return res;
+	}
+
+	/*!
+	 * @brief Check that recovered records are the committed ones followed by a prefix of the uncommitted ones
+	 */
+	bool check_prefix(const std::vector<Payload> &record_array, const std::vector<Payload> &expected_array, size_t num_committed) {
+		if (record_array.size() < num_committed || record_array.size() > expected_array.size()) {
+			return false;
+		}
+		for (size_t i = 0; i < record_array.size(); ++i) {
+			if (record_array[i] != expected_array[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+}
+
+/*
+ * Usage: util_test redo_log_test
+ * Append records under the persistence simulator, crash with some of them uncommitted, and check
+ * that recovery of every crash image finds the committed prefix, rejecting torn records and stale
+ * records of the crashed epoch.
+ */
+UTIL_TEST_CASE(redo_log_test) {
+	FileDescriptor file(std::filesystem::temp_directory_path().string(), "util_redo_log_test", TEST_POOL_SIZE);
+	file.remove_on_close = true;
+
+	std::vector<Payload> expected_array;
+	{
+		Log log(file, 1, 1);
+		NVM_SIMULATOR.attach(file);
+		for (size_t i = 0; i < TEST_NUM_COMMITTED; ++i) {
+			auto &payload = expected_array.emplace_back(make_payload(1 + i * 40, i));
+			log.append_commit(payload.data(), payload.size(), i);
+		}
+		for (size_t len: TEST_UNCOMMITTED_LEN_ARRAY) {
+			auto &payload = expected_array.emplace_back(make_payload(len, expected_array.size()));
+			log.append(payload.data(), payload.size(), expected_array.size());
+		}
+	}
+
+	int res = 0;
+	size_t num_torn = 0;
+	uint64_t num_image = NVM_SIMULATOR.for_each_crash_image([&](const uint8_t *image, size_t) {
+		NVM_SIMULATOR.load_image(image);
+
+		auto record_array = recover_records(file);
+		if (!check_prefix(record_array, expected_array, TEST_NUM_COMMITTED)) {
+			util::logger_error("Redo log recovers ", record_array.size(), " records, which are not a prefix of appended ones");
+			res = -1;
+			return;
+		}
+		if (record_array.size() != TEST_NUM_COMMITTED) {
+			return;
+		}
+
+		// The first uncommitted record is torn. Rewrite it with the same size in a new epoch,
+		// so that the record after it is stale but lies where the next record is expected.
+		++num_torn;
+		Payload payload = make_payload(TEST_UNCOMMITTED_LEN_ARRAY[0], 0xFF);
+		{
+			Log log(file, 1, 1);
+			log.append_commit(payload.data(), payload.size(), TEST_NUM_COMMITTED);
+		}
+		record_array = recover_records(file);
+		if (record_array.size() != TEST_NUM_COMMITTED + 1 || record_array.back() != payload) {
+			util::logger_error("Redo log recovers ", record_array.size(), " records after rewriting a torn record, ",
+			                   "expecting ", TEST_NUM_COMMITTED + 1);
+			res = -1;
+		}
+	});
+	NVM_SIMULATOR.detach();
+
+	// Each line of uncommitted records may or may not be persisted
+	if (num_image != (1U << TEST_NUM_UNCOMMITTED_LINE) || num_torn == 0) {
+		util::logger_error("Redo log leaves ", num_image, " crash images, ", num_torn, " of which have a torn record");
+		res = -1;
+	}
+	return res;
+}
@@ -0,0 +1,143 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/14
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <logger/logger.h>
+#include <thread/thread_numa.h>
+#include <memory/striped_pool.h>
+
+#include "test_case.h"
+
+namespace {
+
+	constexpr size_t TEST_NUM_DEVICE = 3;
+
+	constexpr size_t TEST_SIZE_PER_DEVICE = 64_KB;
+
+	constexpr size_t TEST_STRIPE_SIZE = 1_KB;
+
+	/*!
+	 * @brief Write the logical offset into each word of interleaved view, and read it back
+	 * @return The number of mismatched words
+	 */
+	size_t check_interleaved_words(StripedPool &pool) {
+		size_t interleaved_size = pool.get_interleaved_size();
+		pool.for_each_interleaved_segment(0, interleaved_size, [](uint8_t *segment, size_t segment_len, size_t logical_offset) {
+			for (size_t i = 0; i < segment_len; i += sizeof(uint64_t)) {
+				uint64_t word = logical_offset + i;
+				std::memcpy(segment + i, &word, sizeof(uint64_t));
+			}
+		});
+
+		size_t num_error = 0;
+		for (size_t offset = 0; offset < interleaved_size; offset += sizeof(uint64_t)) {
+			uint64_t word;
+			std::memcpy(&word, pool.get_interleaved_address(offset), sizeof(uint64_t));
+			num_error += word != offset;
+		}
+		return num_error;
+	}
+
+	/*!
+	 * @brief Check that stripes are distributed over devices in round-robin
+	 * @return The number of misplaced stripes
+	 */
+	size_t check_stripe_placement(StripedPool &pool) {
+		size_t num_error = 0;
+		for (size_t stripe_id = 0; stripe_id * TEST_STRIPE_SIZE < pool.get_interleaved_size(); ++stripe_id) {
+			FileDescriptor &device = pool.get_device(stripe_id % pool.get_num_device());
+			uint8_t *expected = device.aligned_start_ptr + stripe_id / pool.get_num_device() * TEST_STRIPE_SIZE;
+			num_error += pool.get_interleaved_address(stripe_id * TEST_STRIPE_SIZE + 8) != expected + 8;
+		}
+		return num_error;
+	}
+
+	bool is_on_device(FileDescriptor &device, const void *ptr, size_t size) {
+		auto *byte_ptr = static_cast<const uint8_t *>(ptr);
+		return byte_ptr >= device.aligned_start_ptr && byte_ptr + size <= device.aligned_start_ptr + device.aligned_total_size;
+	}
+
+}
+
+/*
+ * Usage: util_test striped_pool_test
+ * Build a striped pool on temporary directories. Check that the interleaved view places stripes
+ * over devices in round-robin without overlap, and that NUMA-local allocation takes aligned space
+ * from the device of the node until it is full.
+ */
+UTIL_TEST_CASE(striped_pool_test) {
+	std::filesystem::path root_dir = std::filesystem::temp_directory_path() / "util_striped_pool_test";
+	std::vector<std::string> dir_array;
+	for (size_t i = 0; i < TEST_NUM_DEVICE; ++i) {
+		dir_array.emplace_back((root_dir / ("device" + std::to_string(i))).string());
+	}
+
+	int res = 0;
+	{
+		StripedPool pool(dir_array, "pool", TEST_SIZE_PER_DEVICE, FileMode::CREATE, 0, TEST_STRIPE_SIZE);
+		if (pool.get_num_device() != TEST_NUM_DEVICE ||
+		    pool.get_interleaved_size() != TEST_NUM_DEVICE * util_macro::floor_2pow(pool.get_device(0).aligned_total_size, TEST_STRIPE_SIZE)) {
+			util::logger_error("Striped pool has ", pool.get_num_device(), " devices with interleaved size ", pool.get_interleaved_size());
+			res = -1;
+		}
+
+		// Interleaved view
+		if (size_t num_error = check_stripe_placement(pool); num_error != 0) {
+			util::logger_error("Striped pool misplaces ", num_error, " stripes in interleaved view");
+			res = -1;
+		}
+		if (size_t num_error = check_interleaved_words(pool); num_error != 0) {
+			util::logger_error("Striped pool overlaps ", num_error, " words in interleaved view");
+			res = -1;
+		}
+		size_t num_segment = 0;
+		pool.for_each_interleaved_segment(TEST_STRIPE_SIZE - 8, 2 * TEST_STRIPE_SIZE, [&](uint8_t *, size_t segment_len, size_t) {
+			num_segment += segment_len <= TEST_STRIPE_SIZE;
+		});
+		if (num_segment != 3) {
+			util::logger_error("Striped pool splits an unaligned range into ", num_segment, " segments, expecting 3");
+			res = -1;
+		}
+
+		// NUMA-local view, where each node allocates from its own device if there is one
+		for (int numa_id = 0; numa_id < thread::NUMAConfig::get_max_numa_node(); ++numa_id) {
+			size_t device_id = pool.get_device_of_node(numa_id);
+			for (size_t other_id = 0; other_id < pool.get_num_device(); ++other_id) {
+				if (pool.get_device_node(other_id) == numa_id && pool.get_device_node(device_id) != numa_id) {
+					util::logger_error("Striped pool gives node ", numa_id, " a remote device while a local one exists");
+					res = -1;
+				}
+			}
+		}
+
+		FileDescriptor &local_device = pool.get_local_device();
+		size_t num_block = 0;
+		while (void *block = pool.allocate_local(1000, 256)) {
+			if (!is_on_device(local_device, block, 1000) || reinterpret_cast<uintptr_t>(block) % 256 != 0) {
+				util::logger_error("Striped pool allocates a misplaced block from the local device");
+				res = -1;
+				break;
+			}
+			++num_block;
+		}
+		if (num_block != local_device.aligned_total_size / 1024) {
+			util::logger_error("Striped pool allocates ", num_block, " blocks from the local device, expecting ",
+			                   local_device.aligned_total_size / 1024);
+			res = -1;
+		}
+
+		for (size_t i = 0; i < pool.get_num_device(); ++i) {
+			pool.get_device(i).remove_on_close = true;
+		}
+	}
+	std::filesystem::remove_all(root_dir);
+
+	return res;
+}
@@ -0,0 +1,41 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/6/26
+ */
+
+#pragma once
+#ifndef UTIL_TEST_TEST_CASE_H
+#define UTIL_TEST_TEST_CASE_H
+
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace util::test {
+
+	/// Test case, which returns 0 on success
+	using TestFunc = int (*)(int argc, char **argv);
+
+	inline std::map<std::string, TestFunc, std::less<>> &get_test_case_map() {
+		static std::map<std::string, TestFunc, std::less<>> test_case_map;
+		return test_case_map;
+	}
+
+	struct TestCaseRegister {
+		TestCaseRegister(std::string_view name, TestFunc func) {
+			get_test_case_map().emplace(name, func);
+		}
+	};
+
+}
+
+/*!
+ * @brief Register a test case, whose name should be the same as the source file,
+ * so that ctest can find it (see CMakeLists.txt).
+ */
+#define UTIL_TEST_CASE(name) \
+	static int name(int argc, char **argv); \
+	static util::test::TestCaseRegister name##_register(#name, name); \
+	static int name([[maybe_unused]] int argc, [[maybe_unused]] char **argv)
+
+#endif //UTIL_TEST_TEST_CASE_H
@@ -0,0 +1,204 @@
+/*
+ * @author: BL-GS
+ * @date:   2023/7/14
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <logger/logger.h>
+#include <thread/thread_worker.h>
+#include <memory/file_descriptor.h>
+#include <memory/nvm_simulator.h>
+#include <memory/undo_log.h>
+
+#include "test_case.h"
+
+namespace {
+
+	/*!
+	 * @brief Simulated policy whose fences can be omitted, so as to crash in the middle of log()
+	 */
+	struct NVMFenceOmitted {
+		static inline bool omit_fence = false;
+
+		static void pwb(void *target) {
+			NVMSimulated::pwb(target);
+		}
+
+		static void pwb_range(void *start_ptr, uint32_t size) {
+			NVMSimulated::pwb_range(start_ptr, size);
+		}
+
+		static void fence() {
+			if (!omit_fence) {
+				NVMSimulated::fence();
+			}
+		}
+	};
+
+	using Log = PersistentUndoLog<NVMFenceOmitted>;
+
+	constexpr size_t TEST_POOL_SIZE = 64_KB;
+
+	constexpr uint32_t TEST_NUM_AREA = 4;
+
+	constexpr size_t TEST_NUM_LINE = 8;
+
+	struct alignas(CACHE_LINE_SIZE) Line {
+		uint64_t word[CACHE_LINE_SIZE / sizeof(uint64_t)];
+	};
+
+	using Image = std::vector<uint64_t>;
+
+	Image get_data_image(const Line *line_array) {
+		Image image;
+		for (size_t i = 0; i < TEST_NUM_LINE; ++i) {
+			image.insert(image.end(), std::begin(line_array[i].word), std::end(line_array[i].word));
+		}
+		return image;
+	}
+
+	/*!
+	 * @brief Run a transaction in a registered thread, leaving its unfenced flushes pending at return
+	 */
+	void run_transaction(Log &log, const std::function<void()> &func) {
+		thread::run_workers_on_node(0, 1, [&](int) {
+			log.begin();
+			func();
+		});
+	}
+
+	/*!
+	 * @brief Recover every crash image at this point and check that data becomes the expected image
+	 * @return The number of crash images, or 0 if any of them recovers to unexpected data
+	 */
+	uint64_t check_crash_images(FileDescriptor &log_file, FileDescriptor &data_file, const Line *line_array,
+	                            const Image &expected, std::string_view name) {
+		bool correct = true;
+		uint64_t num_image = NVM_SIMULATOR.for_each_crash_image([&](const uint8_t *image, size_t) {
+			NVM_SIMULATOR.load_image(image);
+			Log log(log_file, data_file, 1, TEST_NUM_AREA);
+			correct = correct && get_data_image(line_array) == expected;
+		});
+		if (!correct) {
+			util::logger_error("Undo log recovers unexpected data after crash in ", name);
+			return 0;
+		}
+		return num_image;
+	}
+
+}
+
+/*
+ * Usage: util_test undo_log_test
+ * Run transactions under the persistence simulator and crash them at several points: in the middle
+ * of a transaction, inside log() before its fence, after abort, after overflow and after commit.
+ * Recovery of every crash image should roll back exactly the unfinished transaction, rejecting torn
+ * entries and stale entries of earlier transactions.
+ */
+UTIL_TEST_CASE(undo_log_test) {
+	std::string dir_name = std::filesystem::temp_directory_path().string();
+	FileDescriptor log_file(dir_name, "util_undo_log_test_log", TEST_POOL_SIZE);
+	FileDescriptor data_file(dir_name, "util_undo_log_test_data", TEST_POOL_SIZE);
+	log_file.remove_on_close = data_file.remove_on_close = true;
+
+	auto *line_array = reinterpret_cast<Line *>(data_file.aligned_start_ptr);
+	for (size_t i = 0; i < TEST_NUM_LINE; ++i) {
+		std::fill(std::begin(line_array[i].word), std::end(line_array[i].word), i);
+	}
+
+	int res = 0;
+	auto log = std::make_unique<Log>(log_file, data_file, 1, TEST_NUM_AREA);
+	NVM_SIMULATOR.attach(log_file);
+	NVM_SIMULATOR.attach(data_file);
+
+	// More lines than later transactions, which leave stale entries in the log
+	run_transaction(*log, [&]() {
+		for (size_t i: { 0, 1, 2, 3, 1 }) {
+			log->store(&line_array[i].word[i], uint64_t{100} + i);
+		}
+		log->commit();
+	});
+	Image committed = get_data_image(line_array);
+
+	// Crash in the middle of transaction, with stores that may or may not be persisted
+	run_transaction(*log, [&]() {
+		log->store(&line_array[1].word[0], uint64_t{200});
+		log->store(&line_array[4].word[0], uint64_t{200});
+		log->store(&line_array[1].word[7], uint64_t{200});
+	});
+	if (check_crash_images(log_file, data_file, line_array, committed, "transaction") <= 1) {
+		res = -1;
+	}
+	// Restart after the crash
+	log = std::make_unique<Log>(log_file, data_file, 1, TEST_NUM_AREA);
+
+	// Crash inside log() before its fence, leaving entries torn
+	run_transaction(*log, [&]() {
+		log->store(&line_array[5].word[0], uint64_t{300});
+		NVMFenceOmitted::omit_fence = true;
+		log->log(&line_array[6], 2 * sizeof(Line));
+		NVMFenceOmitted::omit_fence = false;
+	});
+	if (check_crash_images(log_file, data_file, line_array, committed, "log()") <= 1) {
+		res = -1;
+	}
+	log = std::make_unique<Log>(log_file, data_file, 1, TEST_NUM_AREA);
+
+	// Crash after abort
+	run_transaction(*log, [&]() {
+		log->store(&line_array[0].word[3], uint64_t{400});
+		log->store(&line_array[2].word[5], uint64_t{400});
+		log->abort();
+	});
+	if (get_data_image(line_array) != committed ||
+	    check_crash_images(log_file, data_file, line_array, committed, "abort()") == 0) {
+		util::logger_error("Undo log fails to restore data by abort()");
+		res = -1;
+	}
+	log = std::make_unique<Log>(log_file, data_file, 1, TEST_NUM_AREA);
+
+	// Overflow the log in the first log() and abort, after which lines logged before the overflow
+	// should be logged again by the next transaction
+	run_transaction(*log, [&]() {
+		if (log->log(line_array, (log->get_capacity() + 1) * sizeof(Line))) {
+			util::logger_error("Undo log accepts more lines than its capacity");
+			res = -1;
+		}
+		log->abort();
+
+		log->begin();
+		log->store(&line_array[2].word[0], uint64_t{600});
+		log->abort();
+		if (get_data_image(line_array) != committed) {
+			util::logger_error("Undo log fails to restore data by abort() after overflow");
+			res = -1;
+		}
+
+		log->begin();
+		log->store(&line_array[2].word[0], uint64_t{600});
+	});
+	if (check_crash_images(log_file, data_file, line_array, committed, "transaction after overflow") <= 1) {
+		res = -1;
+	}
+	log = std::make_unique<Log>(log_file, data_file, 1, TEST_NUM_AREA);
+
+	// Crash after commit
+	run_transaction(*log, [&]() {
+		log->store(&line_array[3].word[0], uint64_t{500});
+		log->store(&line_array[7].word[0], uint64_t{500});
+		log->commit();
+	});
+	if (check_crash_images(log_file, data_file, line_array, get_data_image(line_array), "commit()") == 0) {
+		res = -1;
+	}
+
+	NVM_SIMULATOR.detach();
+	return res;
+}